@@ -64,6 +64,7 @@ common:
 	# a specific platform
 	ADDON_SOURCES_EXCLUDE = libs/ffmpeg/%
 	ADDON_SOURCES_EXCLUDE += libs/snappy/%
+	ADDON_SOURCES_EXCLUDE += libs/ofxHap/tests/%
 	
 	# when parsing the file system looking for include paths exclude this for all or
 	# a specific platform
@@ -0,0 +1,57 @@
+/*
+ AdaptiveWindow.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AdaptiveWindow_h
+#define AdaptiveWindow_h
+
+#include <cstdint>
+
+namespace ofxHap {
+    class AdaptiveWindow {
+    public:
+        /*
+         AdaptiveWindow sizes a buffering window between limits. It grows
+         quickly when playback stalls or the load (the time spent providing
+         media as a proportion of its duration) is high, and shrinks slowly
+         when the load is low. Growth is by at least a tenth of a second, so
+         a window with a minimum of zero can recover from it. Times are in
+         AV_TIME_BASE.
+         */
+        AdaptiveWindow(int64_t minimum, int64_t maximum);
+        void    setLimits(int64_t minimum, int64_t maximum);
+        int64_t getMinimum() const;
+        int64_t getMaximum() const;
+        int64_t getWindow() const;
+        void    update(double load, bool stalled);
+    private:
+        int64_t _minimum;
+        int64_t _maximum;
+        int64_t _window;
+    };
+}
+
+#endif /* AdaptiveWindow_h */
@@ -28,36 +28,54 @@
 #ifndef AudioThread_h
 #define AudioThread_h
 
-#include <thread>
-#include <condition_variable>
+#include <mutex>
+#include <atomic>
 #include <queue>
 #include <vector>
+#include <memory>
 #include "AudioParameters.h"
 #include "RingBuffer.h"
 #include "ErrorReceiving.h"
 #include "Clock.h"
+#include "TimeRangeSet.h"
+#include "DemuxPool.h"
 
 typedef struct AVPacket AVPacket;
 typedef struct AVFrame AVFrame;
 
 namespace ofxHap {
-    class AudioThread {
+    class AudioThread : private DemuxPool::Task {
     public:
         class Receiver : public ErrorReceiving {
         public:
             virtual void startAudio() = 0;
             virtual void stopAudio() = 0;
         };
+        /*
+         Audio is decoded and written to the buffer on the shared audio pool,
+         which wakes each player's work as its buffer needs filling, rather
+         than every player having a thread. Receiver's methods are called
+         from the pool's threads.
+         */
         AudioThread(const AudioParameters& params, int outRate, std::shared_ptr<ofxHap::RingBuffer> buffer, Receiver& receiver);
         ~AudioThread();
         AudioThread(AudioThread const &) = delete;
         void        operator=(AudioThread const &x) = delete;
         void        send(AVPacket *packet);
+        void        send(const std::vector<AVPacket *>& packets);
         // sync() send soft == true if the playhead position is unaffected (eg pause) 
         void        sync(const Clock& clock, bool soft);
+        // syncAt() outputs silence until start (from av_gettime_relative()), then plays from the clock
+        void        syncAt(const Clock& clock, int64_t start);
         void        endOfStream();
         void        flush();
         void        setVolume(float v);
+        void        setCache(int64_t usec); // how much decoded audio to keep either side of the playhead
+        void        setPinned(const TimeRangeSet& ranges); // decoded audio to keep regardless (eg the start of a loop)
+        int64_t     getCacheBytes() const; // the memory held by decoded audio
+        // After syncAt(), the microseconds of audio ready to play from the start without a
+        // gap, counting silence outwith the audio track. Zero until measured after a sync
+        int64_t     getBufferedAtStart() const;
     private:
         class Action {
         public:
@@ -108,19 +126,27 @@ namespace ofxHap {
             std::vector<Fade> _fades;
             int _duration;
         };
-        void                                threadMain(AudioParameters params, int ourRate, std::shared_ptr<ofxHap::RingBuffer> buffer);
+        class State; // Only used from run()
+        virtual bool                        run() override;
         static int                          reverse(AVFrame *dst, const AVFrame *src);
         Receiver                            &_receiver;
         std::shared_ptr<ofxHap::RingBuffer> _buffer;
-        std::thread                         _thread;
-        std::condition_variable             _condition;
+        const AudioParameters               _params;
+        const int                           _outRate;
+        std::unique_ptr<State>              _state;
+        std::shared_ptr<DemuxPool>          _pool;
+        // Guarded by _lock
         std::mutex                          _lock;
         std::queue<Action>                  _queue;
-        bool                                _finish;
         bool                                _sync;
         bool                                _soft;
+        int64_t                             _startAt;
         Clock                               _clock;
         float                               _volume;
+        int64_t                             _cache;
+        TimeRangeSet                        _pinned;
+        std::atomic<int64_t>                _cacheBytes;
+        std::atomic<int64_t>                _bufferedAtStart;
     };
 }
 
@@ -53,6 +53,11 @@ namespace ofxHap {
         float   getRate() const;
         void    setRateAt(float r, int64_t t);
         bool    getDone() const;
+        // Looping and palindrome modes play between in and out, and once mode stops at out.
+        // An out of 0 is the end of the period
+        void    setRegionAt(int64_t in, int64_t out, int64_t t);
+        int64_t getIn() const;
+        int64_t getOut() const;
         void    rescale(int old, int next);
         int64_t period;
         Mode    mode;
@@ -61,6 +66,8 @@ namespace ofxHap {
         int64_t _time;
         bool    _paused;
         float   _rate;
+        int64_t _in;
+        int64_t _out;
     };
 }
 
@@ -50,4 +50,10 @@ extern "C" {
 #define OFX_HAP_HAS_CHANNEL_LAYOUT 0
 #endif
 
+#if (LIBAVFORMAT_VERSION_MAJOR > 58 || (LIBAVFORMAT_VERSION_MAJOR == 58 && LIBAVFORMAT_VERSION_MINOR >= 78))
+#define OFX_HAP_HAS_INDEX_ENTRY_API 1
+#else
+#define OFX_HAP_HAS_INDEX_ENTRY_API 0
+#endif
+
 #endif
@@ -0,0 +1,105 @@
+/*
+ DemuxPool.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DemuxPool_h
+#define DemuxPool_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <memory>
+
+namespace ofxHap {
+    class DemuxPool {
+    public:
+        class Task {
+        public:
+            Task(bool urgent = false); // urgent tasks run before others
+            virtual ~Task();
+            // Do a short slice of work, returning true if more work is ready
+            virtual bool run() = 0;
+        private:
+            friend class DemuxPool;
+            bool _queued;
+            bool _running;
+            bool _again;
+            bool _removed;
+            bool _urgent;
+            bool _timed; // waiting in _timers until _due
+            std::chrono::steady_clock::time_point _due;
+        };
+        /*
+         DemuxPool runs tasks on a fixed number of threads. A task never runs
+         on more than one thread at once. The shared pools last as long as
+         something holds a reference to them:
+         - shared() has a thread per core, for reading movies from local
+           storage. A read holds its thread until the disk returns, so a slow
+           disk delays other movies' reads while all the threads wait on it
+         - network() is for reading movies from the network, whose reads can
+           wait far longer, so they don't hold up reads from local storage
+         - opening() is for calls which block for a long time, such as opening
+           a movie, so they don't hold up reads
+         - audio() is for decoding and mixing audio, which runs on timers
+           rather than each player having a thread
+         - decoding() has a thread per core, for decoding video frames, so
+           decodes and reads don't wait for each other
+         */
+        static std::shared_ptr<DemuxPool> shared();
+        static std::shared_ptr<DemuxPool> network();
+        static std::shared_ptr<DemuxPool> opening();
+        static std::shared_ptr<DemuxPool> audio();
+        static std::shared_ptr<DemuxPool> decoding();
+        DemuxPool(unsigned int threads);
+        ~DemuxPool();
+        DemuxPool(DemuxPool const &) = delete;
+        void operator=(DemuxPool const &x) = delete;
+        void schedule(Task *task); // run the task soon, if it isn't already due to run
+        // run the task after delay, unless it is due to run sooner. Timers due
+        // within a millisecond of each other may run together, slightly early
+        void schedule(Task *task, std::chrono::microseconds delay);
+        void remove(Task *task); // blocks until the task isn't running, after which it won't run again
+    private:
+        static std::shared_ptr<DemuxPool> shared(std::weak_ptr<DemuxPool>& existing, unsigned int threads);
+        void threadMain();
+        void enqueue(Task *task);
+        void wake(Task *task, bool notify);
+        void cancelTimer(Task *task);
+        std::mutex                  _lock;
+        std::condition_variable     _condition;
+        std::condition_variable     _finished;
+        std::deque<Task *>          _queue;
+        std::vector<Task *>         _timers;
+        std::vector<std::thread>    _threads;
+        bool                        _timing; // a thread is waiting for the next timer
+        bool                        _finish;
+    };
+}
+
+#endif /* DemuxPool_h */
@@ -30,11 +30,17 @@
 
 #include <cstdint>
 #include <string>
-#include <thread>
-#include <condition_variable>
+#include <mutex>
+#include <atomic>
 #include <queue>
+#include <deque>
+#include <memory>
+#include <vector>
 #include "ErrorReceiving.h"
+#include "TimeRangeSet.h"
+#include "DemuxPool.h"
 
+typedef struct AVFormatContext AVFormatContext;
 typedef struct AVStream AVStream;
 typedef struct AVPacket AVPacket;
 
@@ -45,47 +51,173 @@ namespace ofxHap {
         virtual void foundStream(AVStream *stream) = 0; // will be called for each stream before readPacket() starts
         virtual void foundAllStreams() = 0; // called once after done calling foundStream()
         virtual void readPacket(AVPacket *packet) = 0;
+        // called with packets in the order they were read, by default calls readPacket() for each
+        virtual void readPackets(const std::vector<AVPacket *>& packets)
+        {
+            for (auto packet : packets)
+            {
+                readPacket(packet);
+            }
+        }
         virtual void discontinuity() = 0;
         virtual void endMovie() = 0;
     };
-    class Demuxer {
+    class Readahead;
+    class Demuxer : private DemuxPool::Task {
     public:
-        Demuxer(const std::string& movie, PacketReceiver& receiver);
+        enum class Streams {
+            All,
+            Video, // audio is reported by foundStream() but not read
+            Audio  // work is done ahead of other demuxers
+        };
+        /*
+         The movie is opened on DemuxPool::opening(), so the blocking calls it
+         makes don't hold up reads. Other work is done on the shared DemuxPool,
+         or DemuxPool::network() for a URL, where reads block for longer.
+         PacketReceiver's methods are called from the pools' threads.
+         If preload is greater than zero and the movie's file is no larger than
+         preload bytes, all its packets are read into memory before foundAllStreams()
+         is called, and no further reads are made from the file.
+         If metadata is a path, stream details are read from that file if it exists,
+         skipping the probe of the movie, or written to it after the probe.
+         streams selects which streams are read, so audio and video can be read
+         by separate Demuxers
+         */
+        Demuxer(const std::string& movie, PacketReceiver& receiver, int64_t preload = 0, const std::string& metadata = std::string(), Streams streams = Streams::All);
         ~Demuxer();
         Demuxer(Demuxer const &) = delete;
         void operator=(Demuxer const &x) = delete;
-        void read(int64_t pts); // read at least up to pts in AV_TIME_BASE
+        /*
+         Urgent seeks, and the reads which follow them, are done before other queued
+         seeks and their reads, such as to read the range being played ahead of the
+         start of a loop. Reads continue from wherever the action before them left
+         off, so an urgent read only goes ahead of other work with the urgent
+         action called before it
+         */
+        void read(int64_t pts, bool urgent = false); // read at least up to pts in AV_TIME_BASE
         int64_t getLastReadTime() const; // not thread-safe, use only from the thread calling read()
-        void cancel(); // stop any active read
-        void seekTime(int64_t time);
+        void cancel(); // stop any active read, and drop any queued actions
+        void seekTime(int64_t time, bool urgent = false);
         int64_t getLastSeekTime() const; // not thread-safe, use only from the thread calling seekTime()
         void seekFrame(int64_t frame);
+        void prefetch(const TimeRange& range); // hint that range in AV_TIME_BASE will be read soon
         /* // TODO:
         void readFrame(int64_t start, int64_t end); // read at least up to frame number in
          */
         bool isActive() const; // true if currently seeking or reading
+        float getPreloadProgress() const; // 0...1
+        bool isPreloaded() const; // true if the movie is being played from memory
+        int64_t getPreloadedBytes() const; // the memory held by preloaded packets
+        class StartupTimes {
+        public:
+            StartupTimes();
+            // Microseconds from creation, or AV_NOPTS_VALUE if not yet reached
+            int64_t opened;
+            int64_t streamsFound;
+            int64_t ready; // foundAllStreams() called
+            bool    cachedMetadata; // true if the probe was skipped
+        };
+        StartupTimes getStartupTimes() const;
+        class QueueStatistics {
+        public:
+            QueueStatistics();
+            size_t      length; // actions waiting to be done
+            size_t      peak;
+            uint64_t    merged; // actions combined with the one before
+            uint64_t    cancelled; // actions dropped by cancel()
+        };
+        QueueStatistics getQueueStatistics() const;
+        class ReadStatistics {
+        public:
+            ReadStatistics();
+            // Totals since creation
+            int64_t     bytes;
+            int64_t     time; // microseconds spent reading
+            int64_t     media; // duration of video read, or of audio if only audio is read, in AV_TIME_BASE
+        };
+        ReadStatistics getReadStatistics() const;
     private:
-        void threadMain(const std::string movie, PacketReceiver& receiver);
+        class Opener : public DemuxPool::Task {
+        public:
+            Opener(Demuxer& d);
+            virtual bool run() override;
+            Demuxer& demuxer;
+        };
+        virtual bool run() override;
+        bool open();
+        bool preloadSome();
+        bool ready();
+        bool process();
+        void startupReached(int64_t StartupTimes::*stage);
+        enum class Stage {
+            Open,
+            Preload,
+            Ready,
+            Done
+        };
+        class PreloadedPackets;
         class Action {
         public:
             enum class Kind {
                 SeekTime,
                 SeekFrame,
                 Read,
+                Prefetch,
                 Cancel
             };
-            Action(Kind k, int64_t p);
+            Action(Kind k, int64_t p, int64_t l = 0, bool u = false);
             Kind kind;
             int64_t pts;
+            int64_t length;
+            bool urgent;
         };
+        void enqueue(const Action& action);
+        bool readsVideo() const;
+        bool readsAudio() const;
+        AVPacket *batchPacket();
+        void deliver();
+        // Only used from run()
+        const std::string       _movie;
+        PacketReceiver&         _receiver;
+        const int64_t           _preload;
+        const std::string       _metadata;
+        const Streams           _streams;
+        Stage                   _stage;
+        AVFormatContext         *_context;
+        AVPacket                *_packet;
+        int                     _videoStreamIndex;
+        int                     _audioStreamIndex;
+        std::unique_ptr<PreloadedPackets> _preloadedPackets;
+        int64_t                 _preloadSize;
+        std::unique_ptr<Readahead> _readahead;
+        std::deque<Action>      _pending;
+        bool                    _urgentLast; // the last action queued went ahead of other work
+        std::vector<TimeRange>  _hints; // prefetches taken from _actions, advised once unlocked
+        int64_t                 _lastReadVideo;
+        int64_t                 _lastReadAudio;
+        size_t                  _next; // when preloaded, the next packet to read from memory
+        std::vector<AVPacket *> _batch; // read but not yet delivered
+        int64_t                 _batchBytes;
+        std::vector<AVPacket *> _spare;
+        ReadStatistics          _unpublished; // added to _readStatistics when we next lock
+        // Only used from the thread calling read() and seekTime()
         int64_t                 _lastRead;
         int64_t                 _lastSeek;
-        std::thread             _thread;
-        std::condition_variable _condition;
+        // Guarded by _lock
         mutable std::mutex      _lock;
-        bool                    _finish;
         std::queue<Action>      _actions;
         bool                    _active;
+        float                   _preloadProgress;
+        int64_t                 _preloadedBytes;
+        bool                    _preloaded;
+        int64_t                 _created;
+        StartupTimes            _startup;
+        QueueStatistics         _queueStatistics;
+        ReadStatistics          _readStatistics;
+        std::shared_ptr<DemuxPool> _pool;
+        Opener                  _opener;
+        std::atomic<bool>       _opening; // until open() is done, run() does nothing
+        std::shared_ptr<DemuxPool> _openPool;
     };
 }
 
@@ -0,0 +1,54 @@
+/*
+ FileIdentity.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FileIdentity_h
+#define FileIdentity_h
+
+#include <cstdint>
+#include <string>
+
+namespace ofxHap {
+    class FileIdentity {
+    public:
+        /*
+         Identifies a local file by its path, size and modification time, so
+         data derived from the file can be stored and later matched to it
+         */
+        FileIdentity(const std::string& path);
+        bool        isValid() const; // false for URLs and files which don't exist
+        std::string getKey() const; // hexadecimal, suitable for use in a file name
+        int64_t     getSize() const;
+        bool        operator==(const FileIdentity& o) const;
+        bool        operator!=(const FileIdentity& o) const;
+    private:
+        std::string _path;
+        int64_t     _size;
+        int64_t     _modified;
+    };
+}
+
+#endif /* FileIdentity_h */
@@ -0,0 +1,64 @@
+/*
+ FrameIndex.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FrameIndex_h
+#define FrameIndex_h
+
+#include <cstdint>
+#include <vector>
+
+typedef struct AVStream AVStream;
+
+namespace ofxHap {
+    class FrameIndex {
+    public:
+        /*
+         FrameIndex maps between frame numbers and times for a video stream,
+         using the container's index so it is exact at any frame rate.
+         Times are in the stream's time_base.
+         */
+        FrameIndex();
+        void    build(AVStream *stream); // call before reading from the stream
+        void    clear();
+        bool    isValid() const;
+        int64_t size() const;
+        int64_t getFrame(int64_t pts) const; // the frame showing at pts, clamped to the first and last frames
+        int64_t getTime(int64_t frame) const;
+        int64_t getDuration(int64_t frame) const;
+        int64_t getPosition(int64_t frame) const; // byte offset in the file
+    private:
+        class Entry {
+        public:
+            int64_t pts;
+            int64_t duration;
+            int64_t position;
+        };
+        std::vector<Entry>  _entries;
+    };
+}
+
+#endif /* FrameIndex_h */
@@ -0,0 +1,112 @@
+/*
+ MappedFrameCache.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MappedFrameCache_h
+#define MappedFrameCache_h
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "DemuxPool.h"
+
+namespace ofxHap {
+    class MappedFrameCache : private DemuxPool::Task {
+    public:
+        /*
+         MappedFrameCache stores fixed-size decoded frames in a memory-mapped
+         file so they can be reused by later plays of the same movie.
+         Frames are only ever added, so pointers returned by fetch() remain
+         valid for the lifetime of the cache. Players opening the same path
+         share an instance, and the file is locked against other processes.
+         Frames are flushed to disk before the file records them, so a crash
+         loses recent frames rather than leaving bad ones. Flushes are made in
+         batches on DemuxPool::opening(), so they don't hold up reads.
+         The least recently used files with the same extension in the same
+         directory are deleted to keep them all within limit bytes.
+         Returns nullptr if the file couldn't be mapped, is in use by another
+         process or wouldn't fit within the limit.
+         */
+        static std::shared_ptr<MappedFrameCache> open(const std::string& path, size_t frameSize, int64_t frameCount, uint32_t format, int64_t limit);
+        ~MappedFrameCache();
+        MappedFrameCache(MappedFrameCache const &) = delete;
+        void operator=(MappedFrameCache const &x) = delete;
+        size_t      getFrameSize() const;
+        // Returns the frame covering pts, setting its start and duration, or nullptr
+        const char *fetch(int64_t pts, int64_t& start, int64_t& duration) const;
+        // Adds a frame, if there is space for it and it isn't already present
+        void        store(int64_t pts, int64_t duration, const char *data);
+    private:
+        MappedFrameCache(const std::string& path, size_t frameSize, int64_t frameCount, uint32_t format);
+        static size_t dataOffset(int64_t frameCount);
+        virtual bool run() override;
+        bool        map(size_t length);
+        void        unmap();
+        void        flush();
+        void        sync(size_t offset, size_t length);
+        struct Header {
+            char        magic[8];
+            uint32_t    version;
+            uint32_t    format;
+            uint64_t    frameSize;
+            uint64_t    frameCount;
+            uint64_t    used;
+        };
+        struct Entry {
+            int64_t     pts;
+            int64_t     duration;
+        };
+        struct Slot {
+            int64_t     duration;
+            uint64_t    index;
+            bool        written; // until set, the frame is being copied in
+        };
+        mutable std::mutex      _lock;
+        std::string             _path;
+        size_t                  _frameSize;
+        int64_t                 _frameCount;
+        size_t                  _dataOffset;
+        std::map<int64_t, Slot> _slots;
+        std::vector<bool>       _written; // by index, for slots stored since opening
+        uint64_t                _complete; // slots before this index have all been written
+        uint64_t                _published; // frames recorded in the file's header
+        std::shared_ptr<DemuxPool>  _pool;
+        char                    *_data;
+        size_t                  _length;
+#if defined(_WIN32)
+        void                    *_file;
+        void                    *_mapping;
+#else
+        int                     _file;
+#endif
+    };
+}
+
+#endif /* MappedFrameCache_h */
@@ -0,0 +1,109 @@
+/*
+ MemoryBudget.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MemoryBudget_h
+#define MemoryBudget_h
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include "DemuxPool.h"
+
+namespace ofxHap {
+    class MemoryBudget : private DemuxPool::Task {
+    public:
+        enum class Tier {
+            Preload,    // movies read entirely into memory
+            Packets,    // read but undecoded video
+            Audio,      // decoded audio
+            Frames      // decoded video frames
+        };
+        static const int kTierCount = 4;
+        /*
+         A Client reports the memory its caches hold, and is given a scale
+         (0...1) to apply to its read-ahead and cache windows. A client must
+         only be used from one thread at a time.
+         */
+        class Client {
+        public:
+            Client(std::shared_ptr<MemoryBudget> budget);
+            ~Client();
+            Client(Client const &) = delete;
+            void    operator=(Client const &x) = delete;
+            // Clients with lower priority are shrunk first, and grown last
+            void    setPriority(int priority);
+            int     getPriority() const;
+            void    setUsage(Tier tier, int64_t bytes);
+            void    setUsage(const int64_t (&bytes)[kTierCount]); // every tier at once
+            int64_t getUsage(Tier tier) const;
+            int64_t getUsage() const;
+            float   getScale() const;
+        private:
+            friend class MemoryBudget;
+            std::shared_ptr<MemoryBudget>   _budget;
+            int                             _priority;
+            int64_t                         _usage[kTierCount];
+            float                           _scale;
+        };
+        /*
+         MemoryBudget keeps the memory held by all its clients within a limit,
+         and within what the system can spare, by shrinking the windows of the
+         lowest priority clients first. The shared budget lasts for the life
+         of the process, so its limit can be set before any client exists.
+         What the system can spare is sampled on the opening pool, so clients
+         never wait on the system's reports.
+         */
+        static std::shared_ptr<MemoryBudget> shared();
+        MemoryBudget();
+        ~MemoryBudget();
+        MemoryBudget(MemoryBudget const &) = delete;
+        void    operator=(MemoryBudget const &x) = delete;
+        void    setLimit(int64_t bytes); // 0 for no limit other than system memory
+        int64_t getLimit() const;
+        int64_t getUsage() const;
+        int64_t getUsage(Tier tier) const;
+        bool    isPressured() const; // true if the system is short of memory
+    private:
+        typedef std::chrono::steady_clock::time_point Time;
+        virtual bool run() override; // samples the system's memory
+        void    add(Client *client);
+        void    remove(Client *client);
+        void    balance();
+        int64_t getUsageLocked() const;
+        std::shared_ptr<DemuxPool> _pool;
+        mutable std::mutex      _lock;
+        std::vector<Client *>   _clients;
+        int64_t                 _limit;
+        std::atomic<int64_t>    _available; // bytes the system can spare, or -1 if unknown
+        std::atomic<bool>       _pressured;
+        Time                    _lastBalance;
+    };
+}
+
+#endif /* MemoryBudget_h */
@@ -0,0 +1,82 @@
+/*
+ MovieMetadata.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MovieMetadata_h
+#define MovieMetadata_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef struct AVFormatContext AVFormatContext;
+
+namespace ofxHap {
+    class MovieMetadata {
+    public:
+        /*
+         MovieMetadata holds the stream details which avformat_find_stream_info()
+         works out by reading into a movie, so they can be stored alongside it
+         and restored on a later open, skipping the probe.
+         */
+        MovieMetadata();
+        bool    isValid() const;
+        void    capture(const AVFormatContext *context);
+        bool    apply(AVFormatContext *context) const; // false if the context's streams don't match
+        bool    load(const std::string& path);
+        bool    save(const std::string& path) const;
+    private:
+        class Stream {
+        public:
+            int         type;
+            int         codecID;
+            uint32_t    codecTag;
+            int         timeBaseNum;
+            int         timeBaseDen;
+            int64_t     start;
+            int64_t     duration;
+            int64_t     frames;
+            int         frameRateNum;
+            int         frameRateDen;
+            int         format;
+            int64_t     bitRate;
+            int         width;
+            int         height;
+            int         sampleRate;
+            int         channels;
+            uint64_t    channelLayout;
+            int         frameSize;
+            int         blockAlign;
+            int         bitsPerCodedSample;
+        };
+        int64_t             _start;
+        int64_t             _duration;
+        int64_t             _bitRate;
+        std::vector<Stream> _streams;
+    };
+}
+
+#endif /* MovieMetadata_h */
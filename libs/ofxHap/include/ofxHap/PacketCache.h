@@ -29,21 +29,25 @@
 #define PacketCache_h
 
 #include <cstdint>
-#include <map>
+#include <vector>
+#include <algorithm>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include "TimeRangeSet.h"
 
 typedef struct AVPacket AVPacket;
 typedef struct AVFrame AVFrame;
 
 namespace ofxHap {
-    template <class T, T (*Clone)(T), void (*Free)(T), TimeRange (*Query)(T)>
+    template <class T, T (*Clone)(T), void (*Free)(T), TimeRange (*Query)(T), int64_t (*Size)(T)>
     class Cache {
     public:
         /*
-         Cache maintains an active set and a cache
+         Cache maintains an active set and a cache, each kept sorted by start
+         time in contiguous storage, so lookups are a binary search
          */
+        Cache() : _longest(0), _bytes(0) {}
         virtual ~Cache()
         {
             clear();
@@ -52,10 +56,12 @@ namespace ofxHap {
         virtual void store(T p)
         {
             TimeRange range = Query(p);
-            if (_active.find(range.start) == _active.end())
+            auto itr = find(range.start);
+            if (itr == _active.end() || itr->start != range.start)
             {
-                T got = Clone(p);
-                _active.insert(std::make_pair(range.start, got));
+                _active.emplace(itr, range, Clone(p));
+                _longest = std::max(_longest, range.length);
+                _bytes += Size(p);
             }
         }
         // Fetch
@@ -73,21 +79,39 @@ namespace ofxHap {
         {
             clear(_cache);
             clear(_active);
+            _longest = 0;
+        }
+        // The memory held by the active set and cache
+        int64_t getBytes() const
+        {
+            return _bytes;
         }
         // Move the active set to the cache
         virtual void cache()
         {
-            for (const auto& pair : _active)
+            // Merge the two sorted sets, keeping the cached one of any duplicates
+            _merged.clear();
+            _merged.reserve(_cache.size() + _active.size());
+            auto c = _cache.cbegin();
+            auto a = _active.cbegin();
+            while (c != _cache.cend() || a != _active.cend())
             {
-                if (_cache.find(pair.first) == _cache.end())
+                if (a == _active.cend() || (c != _cache.cend() && c->start < a->start))
+                {
+                    _merged.push_back(*c++);
+                }
+                else if (c != _cache.cend() && c->start == a->start)
                 {
-                    _cache.insert(pair);
+                    release(a->item);
+                    ++a;
                 }
                 else
                 {
-                    Free(pair.second);
+                    _merged.push_back(*a++);
                 }
             }
+            _cache.swap(_merged);
+            _merged.clear();
             _active.clear();
         }
         // discards all outwith range from cache, and all from
@@ -97,95 +121,172 @@ namespace ofxHap {
             limit(_cache, ranges, false);
             limit(_active, ranges, true);
         }
+    protected:
+        // Add to the active set, taking ownership of p
+        void adopt(T p)
+        {
+            TimeRange range = Query(p);
+            auto itr = find(range.start);
+            if (itr == _active.end() || itr->start != range.start)
+            {
+                _active.emplace(itr, range, p);
+                _longest = std::max(_longest, range.length);
+                _bytes += Size(p);
+            }
+            else
+            {
+                Free(p);
+            }
+        }
     private:
-        static void clear(std::map<int64_t, T>& map)
+        class Entry {
+        public:
+            Entry(const TimeRange& range, T i) : start(range.start), end(range.start + range.length), item(i) {}
+            int64_t start;
+            int64_t end;
+            T       item;
+        };
+        typename std::vector<Entry>::iterator find(int64_t start)
+        {
+            return std::lower_bound(_active.begin(), _active.end(), start, [](const Entry& e, int64_t t) {
+                return e.start < t;
+            });
+        }
+        void release(T item)
+        {
+            _bytes -= Size(item);
+            Free(item);
+        }
+        void clear(std::vector<Entry>& entries)
         {
-            for (auto& pair : map)
+            for (auto& entry : entries)
             {
-                Free(pair.second);
+                release(entry.item);
             }
-            map.clear();
+            entries.clear();
         }
-        static void limit(std::map<int64_t, T>& map, const TimeRangeSet& ranges, bool active)
+        void limit(std::vector<Entry>& entries, const TimeRangeSet& ranges, bool active)
         {
             if (ranges.size() == 0)
             {
-                clear(map);
+                clear(entries);
             }
             else
             {
-                for (auto itr = map.cbegin(); itr != map.cend();) {
-                    T p = itr->second;
+                // Both are sorted, so walk them together
+                int64_t earliest = ranges.earliest();
+                auto range = ranges.begin();
+                auto kept = entries.begin();
+                for (auto itr = entries.begin(); itr != entries.end(); ++itr)
+                {
                     bool keep = false;
-                    if (active && itr->first >= ranges.earliest())
+                    if (active && itr->start >= earliest)
                     {
                         keep = true;
                     }
                     else
                     {
-                        TimeRange current = Query(p);
-                        for (auto range: ranges)
+                        while (range != ranges.end() && range->latest() < itr->start)
                         {
-                            if (range.intersects(current))
-                            {
-                                keep = true;
-                                break;
-                            }
+                            ++range;
                         }
+                        keep = range != ranges.end() && range->earliest() < itr->end;
                     }
-                    if (!keep)
+                    if (keep)
                     {
-                        Free(p);
-                        itr = map.erase(itr);
+                        *kept++ = *itr;
                     }
                     else
                     {
-                        ++itr;
+                        release(itr->item);
                     }
                 }
+                entries.erase(kept, entries.end());
             }
         }
-        static T fetch(const std::map<int64_t, T>& map, int64_t pts)
+        T fetch(const std::vector<Entry>& entries, int64_t pts) const
         {
-            for (const auto& pair : map)
+            // Find the last entry starting at or before pts, then look back only as far
+            // as the longest entry could reach
+            auto itr = std::upper_bound(entries.begin(), entries.end(), pts, [](int64_t t, const Entry& e) {
+                return t < e.start;
+            });
+            while (itr != entries.begin())
             {
-                TimeRange range = Query(pair.second);
-                if (range.start <= pts && range.start + range.length > pts)
+                --itr;
+                if (itr->end > pts)
+                {
+                    return itr->item;
+                }
+                if (itr->start <= pts - _longest)
                 {
-                    return pair.second;
+                    break;
                 }
             }
             return T();
         }
-        std::map<int64_t, T> _active;
-        std::map<int64_t, T> _cache;
+        std::vector<Entry>  _active;
+        std::vector<Entry>  _cache;
+        std::vector<Entry>  _merged; // reused by cache()
+        int64_t             _longest;
+        int64_t             _bytes;
     };
 
+    // Packets and frames from these are pooled, so must be freed with PacketFree() and FrameFree()
+    AVPacket *PacketAlloc();
     AVPacket *PacketClone(AVPacket *p);
     void PacketFree(AVPacket *p);
     TimeRange PacketQuery(AVPacket *p);
+    int64_t PacketSize(AVPacket *p);
 
-    class PacketCache : public Cache<AVPacket *, PacketClone, PacketFree, PacketQuery> {
+    class PacketCache : public Cache<AVPacket *, PacketClone, PacketFree, PacketQuery, PacketSize> {
     };
 
     class LockingPacketCache : public PacketCache {
     public:
+        /*
+         store() and cache() may be called from any thread, and never block:
+         they are passed through an inbox which other calls take in. Other
+         calls must only be made from one thread at a time, and only wait
+         on other threads in the timed fetch().
+         */
+        LockingPacketCache();
+        ~LockingPacketCache();
         virtual void store(AVPacket *p) override;
+        void store(const std::vector<AVPacket *>& packets);
         virtual void cache() override;
-        bool fetch(int64_t pts, AVPacket *p) const;
-        bool fetch(int64_t pts, AVPacket *p, std::chrono::microseconds timeout) const;
+        bool fetch(int64_t pts, AVPacket *p);
+        bool fetch(int64_t pts, AVPacket *p, std::chrono::microseconds timeout);
         virtual void limit(const TimeRangeSet& range) override;
         virtual void clear() override;
     private:
-        mutable std::mutex              _lock;
-        mutable std::condition_variable _condition;
+        class Node {
+        public:
+            Node() : packet(nullptr), cache(false), next(nullptr) {}
+            AVPacket    *packet;
+            bool        cache; // true to move the active set to the cache
+            Node        *next;
+        };
+        static void             push(std::atomic<Node *>& stack, Node *first, Node *last);
+        static Node             *last(Node *first);
+        void                    push(Node *first, Node *last);
+        Node                    *getNodes(size_t count); // linked, in a chain
+        bool                    receive();
+        std::atomic<Node *>     _inbox;
+        std::atomic<Node *>     _spare; // nodes kept for reuse
+        std::mutex              _spareLock; // held to pop from _spare
+        std::atomic<bool>       _waiting;
+        std::mutex              _lock;
+        std::condition_variable _condition;
     };
 
+    AVFrame *FrameAlloc();
     AVFrame *FrameClone(AVFrame *f);
     void FrameFree(AVFrame *f);
     TimeRange FrameQuery(AVFrame *f);
+    int64_t FrameSize(AVFrame *f);
 
-    class AudioFrameCache : public Cache<AVFrame *, FrameClone, FrameFree, FrameQuery> {
+    class AudioFrameCache : public Cache<AVFrame *, FrameClone, FrameFree, FrameQuery, FrameSize> {
     };
 }
 
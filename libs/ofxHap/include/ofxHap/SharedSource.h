@@ -0,0 +1,139 @@
+/*
+ SharedSource.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SharedSource_h
+#define SharedSource_h
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include "Demuxer.h"
+#include "PacketCache.h"
+#include "FileIdentity.h"
+#include "TimeRangeSet.h"
+
+namespace ofxHap {
+    class SharedSource : public PacketReceiver {
+    public:
+        /*
+         SharedSource lets players of the same movie share one video demuxer,
+         the packets it reads, and recently decoded frames. Each subscriber is
+         told about the movie and its streams as if it had opened the movie
+         itself. Audio isn't read, so subscribers read it themselves.
+         Sources are matched by FileIdentity, and last as long as something
+         holds a reference to them.
+         */
+        static std::shared_ptr<SharedSource> get(const std::string& movie, const FileIdentity& identity, const std::string& metadata);
+        SharedSource(const std::string& movie, const std::string& metadata);
+        ~SharedSource();
+        SharedSource(SharedSource const &) = delete;
+        void    operator=(SharedSource const &x) = delete;
+        // No calls are made to a receiver once unsubscribe() returns
+        void    subscribe(PacketReceiver& receiver);
+        void    unsubscribe(PacketReceiver& receiver);
+        size_t  getSubscriberCount() const;
+        std::shared_ptr<Demuxer>            getDemuxer() const;
+        std::shared_ptr<LockingPacketCache> getPackets() const;
+        /*
+         The packet cache and demuxer are shared, so subscribers must all make
+         these calls, and those on the packet cache, from one thread. Debug
+         builds assert that they do, until every subscriber has gone.
+         */
+        // The ranges requested from the demuxer by every subscriber
+        TimeRangeSet        getActive() const;
+        // Records the ranges a subscriber has requested
+        void                setActive(PacketReceiver& receiver, const TimeRangeSet& active);
+        // Forgets a subscriber's requests, and cancels the demuxer's queued reads only if no
+        // other subscriber has requests, so one player moving doesn't cancel another's reads.
+        // Returns true if the demuxer was cancelled
+        bool                cancel(PacketReceiver& receiver);
+        // Keeps packets any subscriber needs, returning the union of every subscriber's keep
+        const TimeRangeSet& limit(PacketReceiver& receiver, const TimeRangeSet& keep, const TimeRangeSet& packets);
+        class Frame {
+        public:
+            Frame();
+            int64_t pts; // in the video stream's time base
+            int64_t duration;
+            std::shared_ptr<const std::vector<char>> data;
+        };
+        // Recently decoded frames may be fetched by any subscriber, from any thread
+        bool    fetchFrame(int64_t position, Frame& frame) const;
+        // Takes the content of buffer, leaving a spare buffer in its place
+        Frame   storeFrame(int64_t pts, int64_t duration, std::vector<char>& buffer);
+        int64_t getFrameBytes() const;
+        // PacketReceiver
+        virtual void foundMovie(int64_t duration) override;
+        virtual void foundStream(AVStream *stream) override;
+        virtual void foundAllStreams() override;
+        virtual void readPacket(AVPacket *packet) override;
+        virtual void readPackets(const std::vector<AVPacket *>& packets) override;
+        virtual void discontinuity() override;
+        virtual void endMovie() override;
+        virtual void error(int averror) override;
+    private:
+        class Subscriber {
+        public:
+            Subscriber(PacketReceiver *r) : receiver(r) {}
+            PacketReceiver  *receiver;
+            TimeRangeSet    keep;
+            TimeRangeSet    packets;
+            TimeRangeSet    active;
+        };
+        void updateActive();
+        void checkConsumer() const; // with _subscriberLock held
+        class StoredFrame {
+        public:
+            int64_t pts;
+            int64_t duration;
+            std::shared_ptr<std::vector<char>> data;
+        };
+        // Held while calling receivers, so they aren't called once unsubscribed
+        mutable std::mutex                  _lock;
+        std::vector<PacketReceiver *>       _receivers;
+        int64_t                             _duration;
+        std::vector<AVStream *>             _streams;
+        bool                                _foundAll;
+        int                                 _error;
+        int                                 _videoStreamIndex;
+        // Never held while calling out, so subscribers may take it with their own locks held
+        mutable std::mutex                  _subscriberLock;
+        std::vector<Subscriber>             _subscribers;
+        mutable std::thread::id             _consumer; // the thread subscribers are updated from
+        TimeRangeSet                        _active; // every subscriber's together
+        TimeRangeSet                        _kept;
+        TimeRangeSet                        _keptPackets;
+        mutable std::mutex                  _frameLock;
+        std::vector<StoredFrame>            _frames; // oldest first
+        std::shared_ptr<std::vector<char>>  _spare;
+        std::shared_ptr<LockingPacketCache> _packets;
+        std::shared_ptr<Demuxer>            _demuxer; // last, so it starts once we are ready
+    };
+}
+
+#endif /* SharedSource_h */
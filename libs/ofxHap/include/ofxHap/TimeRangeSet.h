@@ -29,7 +29,6 @@
 #define TimeRangeSet_h
 
 #include <cstdint>
-#include <list>
 #include <cstddef>
 
 namespace ofxHap {
@@ -47,9 +46,44 @@ namespace ofxHap {
         int64_t start;
         int64_t length;
     };
+    // Contiguous storage which holds a few ranges inline and only allocates
+    // when a set outgrows them, so the sets built every update() stay off the heap
+    class TimeRangeStorage {
+    public:
+        typedef TimeRange* iterator;
+        typedef const TimeRange* const_iterator;
+        TimeRangeStorage();
+        TimeRangeStorage(const TimeRangeStorage& o);
+        TimeRangeStorage(TimeRangeStorage&& o);
+        ~TimeRangeStorage();
+        TimeRangeStorage& operator=(const TimeRangeStorage& o);
+        TimeRangeStorage& operator=(TimeRangeStorage&& o);
+        size_t size() const { return _size; }
+        iterator begin() { return _data; }
+        iterator end() { return _data + _size; }
+        const_iterator begin() const { return _data; }
+        const_iterator end() const { return _data + _size; }
+        TimeRange& back() { return _data[_size - 1]; }
+        const TimeRange& back() const { return _data[_size - 1]; }
+        // Returns an iterator to the inserted range
+        iterator insert(iterator pos, const TimeRange& range);
+        // Returns an iterator to the range after the erased one
+        iterator erase(iterator pos);
+        void push_back(const TimeRange& range);
+        void clear() { _size = 0; }
+    private:
+        static const size_t kInlineCount = 4;
+        void reserve(size_t count);
+        void release();
+        TimeRange *_data;
+        size_t _size;
+        size_t _capacity;
+        alignas(TimeRange) unsigned char _inline[kInlineCount * sizeof(TimeRange)];
+    };
     class TimeRangeSequence;
     class TimeRangeSet {
     public:
+        typedef TimeRangeStorage::const_iterator const_iterator;
         TimeRangeSet();
         TimeRangeSet(const TimeRangeSequence& seq);
         int64_t earliest() const;
@@ -66,32 +100,33 @@ namespace ofxHap {
         size_t size() const { // TODO: could probably delete
             return _ranges.size();
         }
-        std::list<TimeRange>::const_iterator begin() const {
+        const_iterator begin() const {
             return _ranges.begin();
         }
-        std::list<TimeRange>::const_iterator end() const {
+        const_iterator end() const {
             return _ranges.end();
         }
     private:
-        std::list<TimeRange> _ranges;
+        TimeRangeStorage _ranges;
     };
 
     class TimeRangeSequence {
     public:
+        typedef TimeRangeStorage::const_iterator const_iterator;
         void add(const TimeRange& range);
         void remove(const TimeRange& range);
         void remove(const TimeRangeSet& set);
         size_t size() const {
             return _ranges.size();
         }
-        std::list<TimeRange>::const_iterator begin() const {
+        const_iterator begin() const {
             return _ranges.begin();
         }
-        std::list<TimeRange>::const_iterator end() const {
+        const_iterator end() const {
             return _ranges.end();
         }
     private:
-        std::list<TimeRange> _ranges;
+        TimeRangeStorage _ranges;
     };
 }
 
@@ -0,0 +1,80 @@
+/*
+ AdaptiveWindow.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/AdaptiveWindow.h>
+#include <algorithm>
+
+namespace ofxHap {
+    // The least a window grows by, so one which has shrunk to nothing can grow again
+    static const int64_t kAdaptiveWindowMinimumStep = 100000; // a tenth of a second
+}
+
+ofxHap::AdaptiveWindow::AdaptiveWindow(int64_t minimum, int64_t maximum)
+: _minimum(minimum), _maximum(std::max(minimum, maximum)), _window(minimum)
+{
+
+}
+
+void ofxHap::AdaptiveWindow::setLimits(int64_t minimum, int64_t maximum)
+{
+    _minimum = minimum;
+    _maximum = std::max(minimum, maximum);
+    _window = std::max(std::min(_window, _maximum), _minimum);
+}
+
+int64_t ofxHap::AdaptiveWindow::getMinimum() const
+{
+    return _minimum;
+}
+
+int64_t ofxHap::AdaptiveWindow::getMaximum() const
+{
+    return _maximum;
+}
+
+int64_t ofxHap::AdaptiveWindow::getWindow() const
+{
+    return _window;
+}
+
+void ofxHap::AdaptiveWindow::update(double load, bool stalled)
+{
+    int64_t window = _window;
+    if (stalled)
+    {
+        window = std::max(window * 2, window + kAdaptiveWindowMinimumStep);
+    }
+    else if (load > 0.5)
+    {
+        window = std::max(window + window / 4, window + kAdaptiveWindowMinimumStep);
+    }
+    else if (load < 0.25)
+    {
+        window -= std::max(window / 10, int64_t(1));
+    }
+    _window = std::max(std::min(window, _maximum), _minimum);
+}
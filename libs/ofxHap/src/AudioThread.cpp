@@ -38,361 +38,497 @@ extern "C" {
 #include <ofxHap/MovieTime.h>
 #include <ofxHap/PacketCache.h>
 
+namespace ofxHap {
+    class AudioThread::State {
+    public:
+        State(const AudioParameters& p, int outRate, int& result)
+        : params(p), decoder(params, result), resampler(params, outRate), fader(outRate / 20),
+          reversed(nullptr), received(FrameAlloc()), last(AV_NOPTS_VALUE), current(AV_NOPTS_VALUE, 0), start(AV_NOPTS_VALUE),
+          cacheusec(0), playing(false), failed(result < 0)
+        {
+#if OFX_HAP_HAS_CODECPAR
+            sampleRate = params.parameters->sample_rate;
+#if OFX_HAP_HAS_CHANNEL_LAYOUT
+            channels = params.parameters->ch_layout.nb_channels;
+#else
+            channels = params.parameters->channels;
+#endif
+#else
+            sampleRate = params.context->sample_rate;
+            channels = params.context->channels;
+#endif
+        }
+        ~State()
+        {
+            if (reversed)
+            {
+                av_frame_free(&reversed);
+            }
+            FrameFree(received);
+        }
+        AudioParameters     params;
+        AudioDecoder        decoder;
+        AudioResampler      resampler;
+        Fader               fader;
+        std::queue<Action>  queue;
+        AudioFrameCache     cache;
+        AVFrame             *reversed;
+        AVFrame             *received;
+        Clock               clock;
+        int64_t             last;
+        TimeRange           current;
+        int64_t             start;
+        int                 sampleRate;
+        int                 channels;
+        int                 cacheusec;
+        TimeRangeSet        pinned;
+        bool                playing;
+        bool                failed; // the decoder couldn't be configured
+    };
+}
+
 ofxHap::AudioThread::AudioThread(const AudioParameters& params ,
                                  int outRate,
                                  std::shared_ptr<ofxHap::RingBuffer> buffer,
                                  Receiver& receiver)
-: _receiver(receiver), _buffer(buffer), _thread(&ofxHap::AudioThread::threadMain, this, params, outRate, buffer),
-  _finish(false), _sync(false), _soft(false)
+: DemuxPool::Task(true), _receiver(receiver), _buffer(buffer), _params(params), _outRate(outRate), _pool(DemuxPool::audio()),
+  _sync(false), _soft(false), _startAt(AV_NOPTS_VALUE), _volume(1.0), _cache(params.cache), _cacheBytes(0), _bufferedAtStart(0)
 {
-
+    // Start work once our members are initialised
+    if (_params.duration != 0)
+    {
+        _pool->schedule(this);
+    }
 }
 
 ofxHap::AudioThread::~AudioThread()
 {
-    { // scope for lock
-        std::unique_lock<std::mutex> locker(_lock);
-        _finish = true;
-        _condition.notify_one();
-    }
-    _thread.join();
+    _pool->remove(this);
 }
 
-void ofxHap::AudioThread::threadMain(AudioParameters params, int outRate, std::shared_ptr<ofxHap::RingBuffer> buffer)
+bool ofxHap::AudioThread::run()
 {
-    if (params.duration == 0)
+    int result = 0;
+    if (!_state)
     {
-        return;
+        // Configure decoder
+        AudioParameters params = _params;
+        if (params.start == AV_NOPTS_VALUE)
+        {
+            params.start = INT64_C(0);
+        }
+        _state.reset(new State(params, _outRate, result));
+        if (result < 0)
+        {
+            _receiver.error(result);
+        }
     }
-    if (params.start == AV_NOPTS_VALUE)
+    if (_state->failed)
     {
-        params.start = INT64_C(0);
+        return false;
     }
 
-    int result = 0;
+    const AudioParameters& params = _state->params;
+    const int outRate = _outRate;
+    const int sampleRate = _state->sampleRate;
+    const int channels = _state->channels;
+    AudioDecoder& decoder = _state->decoder;
+    AudioResampler& resampler = _state->resampler;
+    Fader& fader = _state->fader;
+    std::queue<Action>& queue = _state->queue;
+    AudioFrameCache& cache = _state->cache;
+    AVFrame *&reversed = _state->reversed;
+    AVFrame *received = _state->received;
+    Clock& clock = _state->clock;
+    int64_t& last = _state->last;
+    TimeRange& current = _state->current;
+    int64_t& start = _state->start;
+    int& cacheusec = _state->cacheusec;
+    TimeRangeSet& pinned = _state->pinned;
+    bool& playing = _state->playing;
+
+    // Take in what has changed. Only hold the lock in this { scope }
+    {
+        std::unique_lock<std::mutex> locker(_lock);
 
-    // Configure decoder
-    AudioDecoder decoder(params, result);
+        queue.swap(_queue);
 
-    if (result < 0)
-    {
-        _receiver.error(result);
+        if (_sync)
+        {
+            bool started = clock.getPaused() && !_clock.getPaused();
+            clock = _clock;
+            clock.rescale(AV_TIME_BASE, sampleRate);
+            if (_soft)
+            {
+                // Don't lose playhead position
+                last = av_rescale_q(av_gettime_relative(), {1, AV_TIME_BASE}, {1, sampleRate});
+                if (started)
+                {
+                    fader.add(0, 0.0, 1.0);
+                }
+            }
+            else
+            {
+                last = AV_NOPTS_VALUE;
+                current.start = AV_NOPTS_VALUE;
+            }
+            resampler.setRate(_clock.getRate());
+            start = _startAt == AV_NOPTS_VALUE ? AV_NOPTS_VALUE : av_rescale_q(_startAt, {1, AV_TIME_BASE}, {1, sampleRate});
+            _soft = false;
+            _sync = false;
+        }
+
+        resampler.setVolume(_volume);
+
+        cacheusec = static_cast<int>(av_rescale_q(_cache, {1, AV_TIME_BASE}, {1, sampleRate}));
+        pinned.clear();
+        for (const auto& range : _pinned)
+        {
+            pinned.add(av_rescale_q(range.start, {1, AV_TIME_BASE}, {1, sampleRate}),
+                       av_rescale_q(range.length, {1, AV_TIME_BASE}, {1, sampleRate}));
+        }
     }
 
-    if (result >= 0)
-    {
-#if OFX_HAP_HAS_CODECPAR
-        int sampleRate = params.parameters->sample_rate;
-#if OFX_HAP_HAS_CHANNEL_LAYOUT
-        int channels = params.parameters->ch_layout.nb_channels;
-#else
-        int channels = params.parameters->channels;
-#endif
-#else
-        int sampleRate = params.context->sample_rate;
-        int channels = params.context->channels;
-#endif
-        AudioResampler resampler(params, outRate);
-        Fader fader(outRate / 20);
-        bool finish = false;
-        std::queue<Action> queue;
-        AudioFrameCache cache;
-        AVFrame *reversed = nullptr;
-        Clock clock;
-        int64_t last = AV_NOPTS_VALUE;
-        TimeRange current(AV_NOPTS_VALUE, 0);
+    while (queue.size() > 0) {
+
+        const Action& action = queue.front();
+        if (action.kind == Action::Kind::Send)
+        {
+            result = decoder.send(action.packet);
+            while (result >= 0 && received) {
+                result = decoder.receive(received);
+                if (result >= 0)
+                {
+                    cache.store(received);
+                    // TODO: we might be waiting to send samples onwards immediately at this point
+                    // so should do that before finishing the loops
+                }
+                av_frame_unref(received);
+            }
+
+            if (result < 0 && result != AVERROR(EAGAIN) && result != AVERROR_EOF)
+            {
+                _receiver.error(result);
+            }
+        }
+        result = 0;
 
-        int cacheusec = static_cast<int>(av_rescale_q(params.cache, {1, AV_TIME_BASE}, {1, sampleRate}));
-        bool playing = false;
+        if (action.kind == Action::Kind::Flush || !action.packet)
+        {
+            // null is queued to signal end of stream, which requires a flush
+            decoder.flush();
+            cache.cache();
+        }
 
-        while (!finish) {
+        queue.pop();
+    }
 
-            while (queue.size() > 0) {
+    int64_t now = av_gettime_relative();
+    int64_t expected = av_rescale_q(now, {1, AV_TIME_BASE}, {1, sampleRate});
 
-                const Action& action = queue.front();
-                if (action.kind == Action::Kind::Send)
-                {
-                    result = decoder.send(action.packet);
-                    while (result >= 0) {
-                        AVFrame *frame = av_frame_alloc();
-                        result = decoder.receive(frame);
-                        if (result >= 0)
-                        {
-                            cache.store(frame);
-                            // TODO: we might be waiting to send samples onwards immediately at this point
-                            // so should do that before finishing the loops
-                        }
-                        av_frame_free(&frame);
-                    }
+    {
+        // Dispose of cached samples we no longer need
+        ofxHap::TimeRangeSet ranges = ofxHap::MovieTime::nextRanges(clock, expected - cacheusec, std::min(clock.period, cacheusec * INT64_C(2)));
+        for (const auto& range : pinned)
+        {
+            ranges.add(range);
+        }
+        cache.limit(ranges);
+        _cacheBytes = cache.getBytes();
+    }
 
-                    if (result < 0 && result != AVERROR(EAGAIN) && result != AVERROR_EOF)
+    if (start != AV_NOPTS_VALUE && expected < start)
+    {
+        // Measure how much from the start can be played, in the order it will be
+        int64_t buffered = 0;
+        bool gap = false;
+        for (const auto& range : MovieTime::nextRanges(clock, start, clock.period))
+        {
+            bool forwards = range.length > 0;
+            int64_t position = range.start;
+            int64_t remaining = std::abs(range.length);
+            while (remaining > 0)
+            {
+                int64_t count = remaining;
+                if (position >= params.start && position < params.start + params.duration)
+                {
+                    AVFrame *frame = cache.fetch(position);
+                    if (!frame)
                     {
-                        _receiver.error(result);
+                        gap = true;
+                        break;
                     }
+                    int64_t pts = frame->best_effort_timestamp;
+                    count = forwards ? pts + frame->nb_samples - position : position - pts + 1;
                 }
-                result = 0;
-
-                if (action.kind == Action::Kind::Flush || !action.packet)
+                else if (forwards && position < params.start)
                 {
-                    // null is queued to signal end of stream, which requires a flush
-                    decoder.flush();
-                    cache.cache();
+                    count = params.start - position;
                 }
-
-                queue.pop();
+                else if (!forwards && position >= params.start + params.duration)
+                {
+                    count = position - (params.start + params.duration) + 1;
+                }
+                count = std::min(count, remaining);
+                buffered += count;
+                remaining -= count;
+                position += forwards ? count : -count;
             }
-
-            int64_t now = av_gettime_relative();
-            int64_t expected = av_rescale_q(now, {1, AV_TIME_BASE}, {1, sampleRate});
-
+            if (gap)
             {
-                // Dispose of cached samples we no longer need
-                ofxHap::TimeRangeSequence ranges = ofxHap::MovieTime::nextRanges(clock, expected - cacheusec, std::min(clock.period, cacheusec * INT64_C(2)));
-                cache.limit(ranges);
+                break;
             }
+        }
+        // A sync since we took in changes makes this stale
+        std::lock_guard<std::mutex> guard(_lock);
+        if (!_sync)
+        {
+            _bufferedAtStart = av_rescale_q(buffered, {1, sampleRate}, {1, AV_TIME_BASE});
+        }
+    }
+
+
+    if (!clock.getPaused())
+    {
+        float *dst[2];
+        int count[2];
+        int filled = 0;
 
+        _buffer->writeBegin(dst[0], count[0], dst[1], count[1]);
+
+        // Be more tolerant of being ahead than behind, because some outputs take a while to start consuming samples
+        if (last == AV_NOPTS_VALUE || expected - last > _buffer->getSamplesPerChannel() || last - expected > _buffer->getSamplesPerChannel() * 2)
+        {
+            // Drift, hopefully due to missing packets
+            last = expected;
+            current.start = AV_NOPTS_VALUE;
+        }
 
-            if (!clock.getPaused())
+        for (int i = 0; i < 2; i++) {
+            while (count[i] > 0)
             {
-                float *dst[2];
-                int count[2];
-                int filled = 0;
+                // Only queue (roughly) as many samples as we need to fill the buffer, to avoid choking the resampler
+                int countInMax = static_cast<int>(av_rescale_q(count[i], {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}, {1, sampleRate}));
 
-                _buffer->writeBegin(dst[0], count[0], dst[1], count[1]);
+                int written = 0;
+                int consumed = 0;
 
-                // Be more tolerant of being ahead than behind, because some outputs take a while to start consuming samples
-                if (last == AV_NOPTS_VALUE || expected - last > _buffer->getSamplesPerChannel() || last - expected > _buffer->getSamplesPerChannel() * 2)
+                if (start != AV_NOPTS_VALUE && last < start)
                 {
-                    // Drift, hopefully due to missing packets
-                    last = expected;
+                    // Output silence until a scheduled start, so the first sample is on time
+                    written = static_cast<int>(std::min(static_cast<int64_t>(count[i]), std::max(av_rescale_q(start - last, {1, sampleRate}, {1, outRate}), INT64_C(1))));
+                    av_samples_set_silence((uint8_t **)&dst[i], 0, written, channels, AV_SAMPLE_FMT_FLT);
+                    count[i] -= written;
+                    dst[i] += written * channels;
+                    filled += written;
+                    now = av_add_stable({1, AV_TIME_BASE}, now, {1, outRate}, written);
+                    last = av_add_stable({1, sampleRate}, last, {1, outRate}, written);
                     current.start = AV_NOPTS_VALUE;
+                    continue;
                 }
 
-                for (int i = 0; i < 2; i++) {
-                    while (count[i] > 0)
-                    {
-                        // Only queue (roughly) as many samples as we need to fill the buffer, to avoid choking the resampler
-                        int countInMax = static_cast<int>(av_rescale_q(count[i], {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}, {1, sampleRate}));
-
-                        int written = 0;
-                        int consumed = 0;
+                if (current.start == AV_NOPTS_VALUE || current.length == 0)
+                {
+                    current = MovieTime::nextRange(clock, last, clock.period);
+                    fader.clear();
+                    fader.add(0, 0.0, 1.0);
+                    fader.add(av_rescale_q(std::abs(current.length), {1, sampleRate}, {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}) - fader.getFadeDuration(), 1.0, 0.0);
+                }
 
-                        if (current.start == AV_NOPTS_VALUE || current.length == 0)
+                if (current.start < params.start || current.start > params.start + params.duration)
+                {
+                    if (current.start < params.start)
+                    {
+                        if (current.length < 0)
                         {
-                            current = MovieTime::nextRange(clock, last, clock.period);
-                            fader.clear();
-                            fader.add(0, 0.0, 1.0);
-                            fader.add(av_rescale_q(std::abs(current.length), {1, sampleRate}, {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}) - fader.getFadeDuration(), 1.0, 0.0);
+                            consumed = static_cast<int>(current.start) + 1;
                         }
-
-                        if (current.start < params.start || current.start > params.start + params.duration)
+                        else
                         {
-                            if (current.start < params.start)
-                            {
-                                if (current.length < 0)
-                                {
-                                    consumed = static_cast<int>(current.start) + 1;
-                                }
-                                else
-                                {
-                                    consumed = static_cast<int>(params.start - current.start);
-                                }
-                            }
-                            else
-                            {
-                                if (current.length < 0)
-                                {
-                                    consumed = static_cast<int>(current.start - (params.start + params.duration));
-                                }
-                                else
-                                {
-                                    consumed = static_cast<int>(clock.period - current.start);
-                                }
-                            }
-                            consumed = std::min(consumed, static_cast<int>(std::abs(current.length)));
-                            written = static_cast<int>(av_rescale_q(consumed, {1, sampleRate}, {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}));
-                            if (written > count[i])
-                            {
-                                written = count[i];
-                                consumed = static_cast<int>(av_rescale_q(written, {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}, {1, sampleRate}));
-                            }
-                            av_samples_set_silence((uint8_t **)&dst[i], 0, written, channels, AV_SAMPLE_FMT_FLT);
+                            consumed = static_cast<int>(params.start - current.start);
+                        }
+                    }
+                    else
+                    {
+                        if (current.length < 0)
+                        {
+                            consumed = static_cast<int>(current.start - (params.start + params.duration));
                         }
                         else
                         {
-                            AVFrame *frame = cache.fetch(current.start);
-                            if (frame)
-                            {
-                                int64_t pts = frame->best_effort_timestamp;
-                                if (current.length > 0)
-                                {
-                                    // TODO: we could maybe request samples from resampler and only feed it if it's empty
-                                    // and then feed it the entire next chunk - then reset obv on reposition, etc
-                                    // Fill forwards
-                                    consumed = static_cast<int>(std::min(current.length, (frame->nb_samples - (current.start - pts))));
-                                    consumed = std::min(consumed, countInMax);
-                                    result = resampler.resample(frame, static_cast<int>(current.start - pts), consumed, dst[i], count[i], written, consumed);
-                                }
-                                else
-                                {
-                                    // Fill backwards
-                                    consumed = static_cast<int>(std::min(std::abs(current.length), (current.start - pts) + 1));
-                                    consumed = std::min(consumed, countInMax);
-                                    if (reversed == nullptr)
-                                    {
-                                        reversed = av_frame_alloc();
-                                        if (!reversed)
-                                        {
-                                            result = AVERROR(ENOMEM);
-                                        }
-                                    }
-
-                                    int64_t rpts = reversed->best_effort_timestamp;
-                                    if (result >= 0 && rpts != pts)
-                                    {
-                                        result = reverse(reversed, frame);
-                                        rpts = reversed->best_effort_timestamp;
-                                    }
-
-                                    if (result >= 0)
-                                    {
-                                        int offset = static_cast<int>(rpts + reversed->nb_samples - 1 - current.start);
-                                        result = resampler.resample(reversed, offset, consumed, dst[i], count[i], written, consumed);
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                consumed = written = 0;
-                                break;
-                            }
+                            consumed = static_cast<int>(clock.period - current.start);
                         }
-
-                        fader.apply(dst[i], channels, written);
-
-                        if (written > 0)
+                    }
+                    consumed = std::min(consumed, static_cast<int>(std::abs(current.length)));
+                    written = static_cast<int>(av_rescale_q(consumed, {1, sampleRate}, {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}));
+                    if (written > count[i])
+                    {
+                        written = count[i];
+                        consumed = static_cast<int>(av_rescale_q(written, {1, static_cast<int>(outRate / std::fabs(clock.getRate()))}, {1, sampleRate}));
+                    }
+                    av_samples_set_silence((uint8_t **)&dst[i], 0, written, channels, AV_SAMPLE_FMT_FLT);
+                }
+                else
+                {
+                    AVFrame *frame = cache.fetch(current.start);
+                    if (frame)
+                    {
+                        int64_t pts = frame->best_effort_timestamp;
+                        if (current.length > 0)
                         {
-                            count[i] -= written;
-                            dst[i] += written * channels;
-                            filled += written;
-                            now = av_add_stable({1, AV_TIME_BASE}, now, {1, outRate}, written);
+                            // TODO: we could maybe request samples from resampler and only feed it if it's empty
+                            // and then feed it the entire next chunk - then reset obv on reposition, etc
+                            // Fill forwards
+                            consumed = static_cast<int>(std::min(current.length, (frame->nb_samples - (current.start - pts))));
+                            consumed = std::min(consumed, countInMax);
+                            result = resampler.resample(frame, static_cast<int>(current.start - pts), consumed, dst[i], count[i], written, consumed);
                         }
-                        if (consumed > 0)
+                        else
                         {
-                            last = av_add_stable({1, sampleRate}, last, {1, static_cast<int>(sampleRate * std::fabs(clock.getRate()))}, consumed);
-                            if (current.length > 0)
+                            // Fill backwards
+                            consumed = static_cast<int>(std::min(std::abs(current.length), (current.start - pts) + 1));
+                            consumed = std::min(consumed, countInMax);
+                            if (reversed == nullptr)
                             {
-                                current.start += consumed;
-                                current.length -= consumed;
+                                reversed = av_frame_alloc();
+                                if (!reversed)
+                                {
+                                    result = AVERROR(ENOMEM);
+                                }
                             }
-                            else
+
+                            int64_t rpts = reversed->best_effort_timestamp;
+                            if (result >= 0 && rpts != pts)
                             {
-                                current.start -= consumed;
-                                current.length += consumed;
+                                result = reverse(reversed, frame);
+                                rpts = reversed->best_effort_timestamp;
                             }
-                        }
-
-                        if (result < 0)
-                        {
-                            _receiver.error(result);
-                            break;
-                        }
-                        result = 0;
 
-                        if (written == 0)
-                        {
-                            // If we couldn't write anything, bail
-                            break;
+                            if (result >= 0)
+                            {
+                                int offset = static_cast<int>(rpts + reversed->nb_samples - 1 - current.start);
+                                result = resampler.resample(reversed, offset, consumed, dst[i], count[i], written, consumed);
+                            }
                         }
                     }
-                    if (count[i] > 0)
+                    else
                     {
-                        // don't leave gaps
+                        consumed = written = 0;
                         break;
                     }
                 }
-                _buffer->writeEnd(filled);
-            }
-            if (playing == false && clock.getPaused() == false)
-            {
-                _receiver.startAudio();
-                playing = true;
-            }
-            else if (playing == true && (clock.getPaused() || clock.getDone()))
-            {
-                // Wait for the buffer to drain before stopping audio
-                float *buffers[2];
-                int counts[2];
-                _buffer->writeBegin(buffers[0], counts[0], buffers[1], counts[1]);
-                if (counts[0] + counts[1] == _buffer->getSamplesPerChannel())
-                {
-                    _receiver.stopAudio();
-                    playing = false;
-                }
-                _buffer->writeEnd(0);
-            }
 
-            // Only hold the lock in this { scope }
-            {
-                std::unique_lock<std::mutex> locker(_lock);
-                if (playing == false)
+                fader.apply(dst[i], channels, written);
+
+                if (written > 0)
                 {
-                    _condition.wait(locker);
+                    count[i] -= written;
+                    dst[i] += written * channels;
+                    filled += written;
+                    now = av_add_stable({1, AV_TIME_BASE}, now, {1, outRate}, written);
                 }
-                else
+                if (consumed > 0)
                 {
-                    int64_t next = now + av_rescale_q(_buffer->getSamplesPerChannel() / 2, {1, outRate}, {1, AV_TIME_BASE});
-                    int64_t wait = next - av_gettime_relative();
-                    if (wait > 0)
+                    last = av_add_stable({1, sampleRate}, last, {1, static_cast<int>(sampleRate * std::fabs(clock.getRate()))}, consumed);
+                    if (current.length > 0)
                     {
-                        _condition.wait_for(locker, std::chrono::microseconds(wait));
-                    }
-                }
-
-                queue.swap(_queue);
-
-                finish = _finish;
-
-                if (_sync)
-                {
-                    bool started = clock.getPaused() && !_clock.getPaused();
-                    clock = _clock;
-                    clock.rescale(AV_TIME_BASE, sampleRate);
-                    if (_soft)
-                    {
-                        // Don't lose playhead position
-                        last = av_rescale_q(av_gettime_relative(), {1, AV_TIME_BASE}, {1, sampleRate});
-                        if (started)
-                        {
-                            fader.add(0, 0.0, 1.0);
-                        }
+                        current.start += consumed;
+                        current.length -= consumed;
                     }
                     else
                     {
-                        last = AV_NOPTS_VALUE;
-                        current.start = AV_NOPTS_VALUE;
+                        current.start -= consumed;
+                        current.length += consumed;
                     }
-                    resampler.setRate(_clock.getRate());
-                    _soft = false;
-                    _sync = false;
                 }
 
-                resampler.setVolume(_volume);
+                if (result < 0)
+                {
+                    _receiver.error(result);
+                    break;
+                }
+                result = 0;
+
+                if (written == 0)
+                {
+                    // If we couldn't write anything, bail
+                    break;
+                }
+            }
+            if (count[i] > 0)
+            {
+                // don't leave gaps
+                break;
             }
         }
-
-        if (reversed)
+        _buffer->writeEnd(filled);
+    }
+    if (playing == false && clock.getPaused() == false)
+    {
+        _receiver.startAudio();
+        playing = true;
+    }
+    else if (playing == true && (clock.getPaused() || clock.getDone()))
+    {
+        // Wait for the buffer to drain before stopping audio
+        float *buffers[2];
+        int counts[2];
+        _buffer->writeBegin(buffers[0], counts[0], buffers[1], counts[1]);
+        if (counts[0] + counts[1] == _buffer->getSamplesPerChannel())
         {
-            av_frame_free(&reversed);
+            _receiver.stopAudio();
+            playing = false;
         }
+        _buffer->writeEnd(0);
     }
+
+    if (playing)
+    {
+        // Run again when half the buffer has been played
+        int64_t next = now + av_rescale_q(_buffer->getSamplesPerChannel() / 2, {1, outRate}, {1, AV_TIME_BASE});
+        _pool->schedule(this, std::chrono::microseconds(std::max(INT64_C(0), next - av_gettime_relative())));
+    }
+    // Otherwise we are paused, and run again when something is sent to us
+    return false;
 }
 
 void ofxHap::AudioThread::send(AVPacket *p)
 {
     std::lock_guard<std::mutex> guard(_lock);
     _queue.emplace(p);
-    _condition.notify_one();
+    _pool->schedule(this);
+}
+
+void ofxHap::AudioThread::send(const std::vector<AVPacket *>& packets)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    for (auto packet : packets)
+    {
+        _queue.emplace(packet);
+    }
+    _pool->schedule(this);
+}
+
+void ofxHap::AudioThread::setCache(int64_t usec)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _cache = usec;
+}
+
+void ofxHap::AudioThread::setPinned(const TimeRangeSet& ranges)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _pinned = ranges;
+}
+
+int64_t ofxHap::AudioThread::getCacheBytes() const
+{
+    return _cacheBytes;
+}
+
+int64_t ofxHap::AudioThread::getBufferedAtStart() const
+{
+    return _bufferedAtStart;
 }
 
 void ofxHap::AudioThread::sync(const Clock& clock, bool soft)
@@ -408,15 +544,28 @@ void ofxHap::AudioThread::sync(const Clock& clock, bool soft)
         // Don't set _soft to true if there is already a pending hard sync
         _soft = true;
     }
+    _startAt = AV_NOPTS_VALUE;
     _sync = true;
-    _condition.notify_one();
+    _bufferedAtStart = 0;
+    _pool->schedule(this);
+}
+
+void ofxHap::AudioThread::syncAt(const Clock& clock, int64_t start)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _clock = clock;
+    _soft = false;
+    _startAt = start;
+    _sync = true;
+    _bufferedAtStart = 0;
+    _pool->schedule(this);
 }
 
 void ofxHap::AudioThread::flush()
 {
     std::lock_guard<std::mutex> guard(_lock);
     _queue.emplace();
-    _condition.notify_one();
+    _pool->schedule(this);
 }
 
 void ofxHap::AudioThread::endOfStream()
@@ -424,14 +573,14 @@ void ofxHap::AudioThread::endOfStream()
     std::lock_guard<std::mutex> guard(_lock);
     // Send null to signal end
     _queue.emplace(nullptr);
-    _condition.notify_one();
+    _pool->schedule(this);
 }
 
 void ofxHap::AudioThread::setVolume(float v)
 {
     std::lock_guard<std::mutex> guard(_lock);
     _volume = v;
-    _condition.notify_one();
+    _pool->schedule(this);
 }
 
 int ofxHap::AudioThread::reverse(AVFrame *dst, const AVFrame *src)
@@ -503,35 +652,12 @@ ofxHap::AudioThread::Action::Action()
 { }
 
 ofxHap::AudioThread::Action::Action(AVPacket *p)
-: kind(Kind::Send),
-#if OFX_HAP_HAS_PACKET_ALLOC
-packet(p ? av_packet_clone(p) : p)
-#else
-packet(static_cast<AVPacket *>(av_malloc(sizeof(AVPacket))))
-#endif
-{
-#if !OFX_HAP_HAS_PACKET_ALLOC
-    if (p)
-    {
-        av_init_packet(packet);
-        packet->data = nullptr;
-        packet->size = 0;
-        av_packet_ref(packet, p);
-    }
-#endif
-}
+: kind(Kind::Send), packet(p ? PacketClone(p) : p)
+{ }
 
 ofxHap::AudioThread::Action::~Action()
 {
-    if (packet)
-    {
-#if OFX_HAP_HAS_PACKET_ALLOC
-        av_packet_free(&packet);
-#else
-        av_packet_unref(packet);
-        av_freep(&packet);
-#endif
-    }
+    PacketFree(packet);
 }
 
 void ofxHap::AudioThread::Fader::add(int64_t delay, float start, float end)
@@ -26,6 +26,7 @@
  */
 
 #include <ofxHap/Clock.h>
+#include <algorithm>
 extern "C" {
 #include <libavutil/avutil.h>
 }
@@ -37,7 +38,7 @@ namespace ofxHap {
     }
 }
 
-ofxHap::Clock::Clock() : period(0), mode(Mode::Loop), _start(0), _time(-1), _paused(false), _rate(1.0)
+ofxHap::Clock::Clock() : period(0), mode(Mode::Loop), _start(0), _time(-1), _paused(false), _rate(1.0), _in(0), _out(0)
 {
 
 }
@@ -56,6 +57,9 @@ int64_t ofxHap::Clock::getTime() const
 int64_t ofxHap::Clock::getTimeAt(int64_t t) const
 {
     t = static_cast<int64_t>((t - _start) * _rate);
+    int64_t in = getIn();
+    int64_t out = getOut();
+    int64_t length = out - in;
 
     if (_paused)
     {
@@ -63,20 +67,20 @@ int64_t ofxHap::Clock::getTimeAt(int64_t t) const
     }
     else if (mode == Mode::Once)
     {
-        if (t > period)
+        if (t > out)
         {
-            return period;
+            return out;
         }
-        else if (t < 0)
+        else if (t < in)
         {
             // Once backwards
-            if (t < -period)
+            if (t < in - length)
             {
-                return 0;
+                return in;
             }
             else
             {
-                return period + t;
+                return out + (t - in);
             }
         }
         else
@@ -84,17 +88,17 @@ int64_t ofxHap::Clock::getTimeAt(int64_t t) const
             return t;
         }
     }
-    else if (period == 0)
+    else if (length == 0)
     {
-        return 0;
+        return in;
     }
-    else if (mode == Mode::Palindrome && clockMod((t / period), 2) == 1)
+    else if (mode == Mode::Palindrome && clockMod(((t - in) / length), 2) == 1)
     {
-        return period - clockMod(t, period) - 1;
+        return out - clockMod(t - in, length) - 1;
     }
     else
     {
-        return clockMod(t, period);
+        return in + clockMod(t - in, length);
     }
 }
 
@@ -134,11 +138,12 @@ ofxHap::Clock::Direction ofxHap::Clock::getDirectionAt(int64_t t) const
     {
         t = static_cast<int64_t>((t - _start) * _rate);
     }
-    if (period == 0)
+    int64_t length = getOut() - getIn();
+    if (length == 0)
     {
         return Direction::Forwards;
     }
-    else if (mode == Mode::Palindrome && clockMod((t / period), 2) == 1)
+    else if (mode == Mode::Palindrome && clockMod(((t - getIn()) / length), 2) == 1)
     {
         if (_rate > 0)
         {
@@ -175,7 +180,34 @@ void ofxHap::Clock::setRateAt(float r, int64_t t)
 
 bool ofxHap::Clock::getDone() const
 {
-    return (mode == Mode::Once && getTime() == period) ? true : false;
+    return (mode == Mode::Once && getTime() == getOut()) ? true : false;
+}
+
+void ofxHap::Clock::setRegionAt(int64_t in, int64_t out, int64_t t)
+{
+    if (!_paused)
+    {
+        setTimeAt(t);
+    }
+    _in = in;
+    _out = out;
+    // Keep our position unless it is now outside the region
+    int64_t time = _time;
+    if (time < getIn() || time > getOut())
+    {
+        time = getIn();
+    }
+    syncAt(time, t);
+}
+
+int64_t ofxHap::Clock::getIn() const
+{
+    return std::max(std::min(_in, getOut()), INT64_C(0));
+}
+
+int64_t ofxHap::Clock::getOut() const
+{
+    return (_out > 0 && _out < period) ? _out : period;
 }
 
 void ofxHap::Clock::rescale(int old, int next)
@@ -183,4 +215,6 @@ void ofxHap::Clock::rescale(int old, int next)
     period = av_rescale_q(period, {1, old}, {1, next});
     _start = av_rescale_q(_start, {1, old}, {1, next});
     _time = av_rescale_q(_time, {1, old}, {1, next});
+    _in = av_rescale_q(_in, {1, old}, {1, next});
+    _out = av_rescale_q(_out, {1, old}, {1, next});
 }
@@ -0,0 +1,275 @@
+/*
+ DemuxPool.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/DemuxPool.h>
+#include <algorithm>
+
+namespace ofxHap {
+    // Timers due this close together are run from one wake
+    static const std::chrono::microseconds kDemuxPoolTimerSlack(1000);
+}
+
+std::shared_ptr<ofxHap::DemuxPool> ofxHap::DemuxPool::shared(std::weak_ptr<DemuxPool>& existing, unsigned int threads)
+{
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<DemuxPool> pool = existing.lock();
+    if (!pool)
+    {
+        pool = std::make_shared<DemuxPool>(threads);
+        existing = pool;
+    }
+    return pool;
+}
+
+std::shared_ptr<ofxHap::DemuxPool> ofxHap::DemuxPool::shared()
+{
+    static std::weak_ptr<DemuxPool> existing;
+    return shared(existing, std::max(2U, std::thread::hardware_concurrency()));
+}
+
+std::shared_ptr<ofxHap::DemuxPool> ofxHap::DemuxPool::network()
+{
+    // Network reads mostly wait, so more can overlap than we have cores
+    static std::weak_ptr<DemuxPool> existing;
+    return shared(existing, std::max(4U, std::thread::hardware_concurrency()));
+}
+
+std::shared_ptr<ofxHap::DemuxPool> ofxHap::DemuxPool::opening()
+{
+    // Opens mostly wait on the disk or network, so a few can overlap
+    static std::weak_ptr<DemuxPool> existing;
+    return shared(existing, 4);
+}
+
+std::shared_ptr<ofxHap::DemuxPool> ofxHap::DemuxPool::audio()
+{
+    static std::weak_ptr<DemuxPool> existing;
+    return shared(existing, std::max(2U, std::thread::hardware_concurrency() / 2));
+}
+
+std::shared_ptr<ofxHap::DemuxPool> ofxHap::DemuxPool::decoding()
+{
+    static std::weak_ptr<DemuxPool> existing;
+    return shared(existing, std::max(1U, std::thread::hardware_concurrency()));
+}
+
+ofxHap::DemuxPool::DemuxPool(unsigned int threads)
+: _timing(false), _finish(false)
+{
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        _threads.emplace_back(&ofxHap::DemuxPool::threadMain, this);
+    }
+}
+
+ofxHap::DemuxPool::~DemuxPool()
+{
+    { // scope for lock
+        std::unique_lock<std::mutex> locker(_lock);
+        _finish = true;
+        _condition.notify_all();
+    }
+    for (auto& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void ofxHap::DemuxPool::schedule(Task *task)
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    if (task->_removed)
+    {
+        return;
+    }
+    cancelTimer(task);
+    wake(task, true);
+}
+
+void ofxHap::DemuxPool::schedule(Task *task, std::chrono::microseconds delay)
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now() + delay;
+    if (task->_removed || task->_queued || (task->_timed && task->_due <= due))
+    {
+        return;
+    }
+    // The thread waiting on timers only has to wake sooner if this is now the
+    // first due. A running task's thread will see its timer when it finishes.
+    bool first = !task->_running && std::none_of(_timers.begin(), _timers.end(), [due](const Task *t) {
+        return t->_due <= due;
+    });
+    task->_due = due;
+    if (!task->_timed)
+    {
+        task->_timed = true;
+        _timers.push_back(task);
+    }
+    if (first)
+    {
+        // We can't wake only the thread waiting on timers
+        _condition.notify_all();
+    }
+}
+
+void ofxHap::DemuxPool::wake(Task *task, bool notify)
+{
+    if (task->_running)
+    {
+        // The thread running it will queue it again when it finishes
+        task->_again = true;
+    }
+    else if (!task->_queued)
+    {
+        enqueue(task);
+        if (notify)
+        {
+            _condition.notify_one();
+        }
+    }
+}
+
+void ofxHap::DemuxPool::cancelTimer(Task *task)
+{
+    if (task->_timed)
+    {
+        _timers.erase(std::find(_timers.begin(), _timers.end(), task));
+        task->_timed = false;
+    }
+}
+
+void ofxHap::DemuxPool::enqueue(Task *task)
+{
+    task->_queued = true;
+    if (task->_urgent)
+    {
+        // After any other urgent tasks, but before the rest
+        auto position = std::find_if(_queue.begin(), _queue.end(), [](const Task *t) {
+            return !t->_urgent;
+        });
+        _queue.insert(position, task);
+    }
+    else
+    {
+        _queue.push_back(task);
+    }
+}
+
+void ofxHap::DemuxPool::remove(Task *task)
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    task->_removed = true;
+    cancelTimer(task);
+    if (task->_queued)
+    {
+        _queue.erase(std::find(_queue.begin(), _queue.end(), task));
+        task->_queued = false;
+    }
+    while (task->_running)
+    {
+        _finished.wait(locker);
+    }
+}
+
+void ofxHap::DemuxPool::threadMain()
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    while (!_finish)
+    {
+        // Queue any tasks whose timers are due, finding the next due if none are
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now() + kDemuxPoolTimerSlack;
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+        bool woken = false;
+        for (auto itr = _timers.begin(); itr != _timers.end();)
+        {
+            Task *task = *itr;
+            if (task->_due <= now)
+            {
+                itr = _timers.erase(itr);
+                task->_timed = false;
+                // This thread takes the first itself, so only wake others for the rest
+                wake(task, woken);
+                woken = true;
+            }
+            else
+            {
+                next = std::min(next, task->_due);
+                ++itr;
+            }
+        }
+        if (_queue.size() == 0)
+        {
+            // Only one idle thread waits on the timers, so the others aren't
+            // woken each time one is due
+            if (_timers.size() == 0 || _timing)
+            {
+                _condition.wait(locker);
+            }
+            else
+            {
+                _timing = true;
+                _condition.wait_until(locker, next);
+                _timing = false;
+            }
+        }
+        else
+        {
+            Task *task = _queue.front();
+            _queue.pop_front();
+            task->_queued = false;
+            // Running now satisfies any timer
+            cancelTimer(task);
+            task->_running = true;
+            task->_again = false;
+
+            locker.unlock();
+            bool more = task->run();
+            locker.lock();
+
+            task->_running = false;
+            // Tasks with more to do go to the back of the queue (or of the urgent
+            // tasks) so others get a turn
+            if ((more || task->_again) && !task->_removed)
+            {
+                enqueue(task);
+            }
+            _finished.notify_all();
+        }
+    }
+}
+
+ofxHap::DemuxPool::Task::Task(bool urgent)
+: _queued(false), _running(false), _again(false), _removed(false), _urgent(urgent), _timed(false)
+{
+
+}
+
+ofxHap::DemuxPool::Task::~Task()
+{
+
+}
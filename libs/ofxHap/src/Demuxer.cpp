@@ -27,223 +27,648 @@
 
 #include <ofxHap/Demuxer.h>
 #include <ofxHap/Common.h>
+#include <ofxHap/Readahead.h>
+#include <ofxHap/MovieMetadata.h>
 extern "C" {
 #include <libavformat/avformat.h>
+#include <libavutil/time.h>
 }
 #include <mutex>
+#include <algorithm>
+#include <cstdlib>
 
-ofxHap::Demuxer::Demuxer(const std::string& movie, PacketReceiver& receiver) :
+namespace ofxHap {
+    static const AVIndexEntry *indexEntry(AVStream *stream, int64_t pts, int flags)
+    {
+        int64_t ts = av_rescale_q(pts, { 1, AV_TIME_BASE }, stream->time_base);
+#if OFX_HAP_HAS_INDEX_ENTRY_API
+        int count = avformat_index_get_entries_count(stream);
+        int index = av_index_search_timestamp(stream, ts, flags | AVSEEK_FLAG_ANY);
+        if (index < 0 && count > 0 && !(flags & AVSEEK_FLAG_BACKWARD))
+        {
+            index = count - 1;
+        }
+        return index < 0 ? nullptr : avformat_index_get_entry(stream, index);
+#else
+        int index = av_index_search_timestamp(stream, ts, flags | AVSEEK_FLAG_ANY);
+        if (index < 0 && stream->nb_index_entries > 0 && !(flags & AVSEEK_FLAG_BACKWARD))
+        {
+            index = stream->nb_index_entries - 1;
+        }
+        return index < 0 ? nullptr : &stream->index_entries[index];
+#endif
+    }
+
+    // Advise the file range holding the stream's samples for range
+    static void adviseRange(AVStream *stream, const TimeRange& range, Readahead& readahead)
+    {
+        const AVIndexEntry *first = indexEntry(stream, range.earliest(), AVSEEK_FLAG_BACKWARD);
+        if (!first)
+        {
+            first = indexEntry(stream, range.earliest(), 0);
+        }
+        const AVIndexEntry *last = indexEntry(stream, range.latest(), AVSEEK_FLAG_BACKWARD);
+        if (first && last)
+        {
+            int64_t start = std::min(first->pos, last->pos);
+            int64_t end = std::max(first->pos, last->pos) + last->size;
+            readahead.advise(start, end - start);
+        }
+    }
+
+    // Packets held in memory in file order
+    class Demuxer::PreloadedPackets {
+    public:
+        PreloadedPackets() : _bytes(0) {}
+        ~PreloadedPackets()
+        {
+            clear();
+        }
+        void add(AVPacket *packet, AVStream *stream)
+        {
+            int64_t end = av_rescale_q(packet->pts + packet->duration, stream->time_base, { 1, AV_TIME_BASE });
+            auto itr = std::find_if(_streams.begin(), _streams.end(), [packet](const Stream& s) {
+                return s.index == packet->stream_index;
+            });
+            if (itr == _streams.end())
+            {
+                itr = _streams.insert(_streams.end(), Stream(packet->stream_index));
+            }
+            // Keep the latest end so far, so each stream's ends are sorted for searching
+            itr->ends.push_back(itr->ends.empty() ? end : std::max(itr->ends.back(), end));
+            itr->packets.push_back(_packets.size());
+            _packets.push_back(av_packet_clone(packet));
+            _bytes += packet->size;
+        }
+        void clear()
+        {
+            for (auto packet : _packets)
+            {
+                av_packet_free(&packet);
+            }
+            _packets.clear();
+            _streams.clear();
+            _bytes = 0;
+        }
+        // The index of the first packet needed to play from time
+        size_t seekTime(int64_t time) const
+        {
+            size_t result = _packets.size();
+            for (const auto& stream : _streams)
+            {
+                auto itr = std::upper_bound(stream.ends.begin(), stream.ends.end(), time);
+                if (itr != stream.ends.end())
+                {
+                    result = std::min(result, stream.packets[itr - stream.ends.begin()]);
+                }
+            }
+            return result;
+        }
+        size_t seekFrame(int64_t frame, int stream) const
+        {
+            for (const auto& s : _streams)
+            {
+                if (s.index == stream && frame >= 0 && frame < static_cast<int64_t>(s.packets.size()))
+                {
+                    return s.packets[frame];
+                }
+            }
+            return _packets.size();
+        }
+        AVPacket *at(size_t index) const
+        {
+            return _packets[index];
+        }
+        size_t size() const
+        {
+            return _packets.size();
+        }
+        int64_t getBytes() const
+        {
+            return _bytes;
+        }
+    private:
+        class Stream {
+        public:
+            Stream(int i) : index(i) {}
+            int                     index;
+            std::vector<int64_t>    ends;
+            std::vector<size_t>     packets; // positions in _packets
+        };
+        std::vector<AVPacket *> _packets;
+        std::vector<Stream>     _streams;
+        int64_t                 _bytes;
+    };
+
+    // Movies with a protocol other than file are read from the network
+    static bool isNetworkMovie(const std::string& movie)
+    {
+        size_t scheme = movie.find("://");
+        return scheme != std::string::npos && movie.compare(0, scheme, "file") != 0;
+    }
+
+    // How many packets are read each time the Demuxer gets a turn in the pool
+    static const int kDemuxerSlicePackets = 32;
+    // How many bytes of packets may be held back to deliver together
+    static const int kDemuxerBatchBytes = 1024 * 1024;
+}
+
+ofxHap::Demuxer::Demuxer(const std::string& movie, PacketReceiver& receiver, int64_t preload, const std::string& metadata, Streams streams) :
+DemuxPool::Task(streams == Streams::Audio),
+_movie(movie), _receiver(receiver), _preload(preload), _metadata(metadata), _streams(streams),
+_stage(movie.length() > 0 ? Stage::Open : Stage::Done),
+_context(nullptr), _packet(nullptr), _videoStreamIndex(-1), _audioStreamIndex(-1),
+_preloadedPackets(new PreloadedPackets()), _preloadSize(0), _urgentLast(false),
+_lastReadVideo(AV_NOPTS_VALUE), _lastReadAudio(AV_NOPTS_VALUE), _next(0), _batchBytes(0),
 _lastRead(AV_NOPTS_VALUE), _lastSeek(AV_NOPTS_VALUE),
-_thread(&ofxHap::Demuxer::threadMain, this, movie, std::ref(receiver)),
-_finish(false), _active(false)
+_active(false), _preloadProgress(0.0), _preloadedBytes(0), _preloaded(false),
+_created(av_gettime_relative()), _pool(isNetworkMovie(movie) ? DemuxPool::network() : DemuxPool::shared()),
+_opener(*this), _opening(_stage == Stage::Open), _openPool(DemuxPool::opening())
 {
-
+    // Start work once our members are initialised
+    if (_stage == Stage::Open)
+    {
+        _openPool->schedule(&_opener);
+    }
 }
 
 ofxHap::Demuxer::~Demuxer()
 {
-    { // scope for lock
-        std::unique_lock<std::mutex> locker(_lock);
-        _finish = true;
-        _condition.notify_one();
+    _openPool->remove(&_opener);
+    _pool->remove(this);
+    av_packet_free(&_packet);
+    for (auto packet : _spare)
+    {
+        av_packet_free(&packet);
+    }
+    if (_context)
+    {
+        avformat_close_input(&_context);
+    }
+}
+
+ofxHap::Demuxer::Opener::Opener(Demuxer& d)
+: demuxer(d)
+{
+
+}
+
+bool ofxHap::Demuxer::Opener::run()
+{
+    bool more = demuxer.open();
+    demuxer._opening.store(false);
+    // Continue on the shared pool
+    if (more)
+    {
+        demuxer._pool->schedule(&demuxer);
     }
-    _thread.join();
+    return false;
 }
 
-void ofxHap::Demuxer::threadMain(const std::string movie, PacketReceiver& receiver)
+bool ofxHap::Demuxer::run()
 {
-    if (movie.length() > 0)
+    if (_opening.load())
     {
-        static std::once_flag registerFlag;
-        std::call_once(registerFlag, [](){
-            av_log_set_level(AV_LOG_QUIET);
-            avformat_network_init();
-        });
-        AVFormatContext *fmt_ctx = NULL;
-        int videoStreamIndex = -1;
-        int audioStreamIndex = -1;
-        int result = avformat_open_input(&fmt_ctx, movie.c_str(), NULL, NULL);
-        if (result == 0)
+        // Scheduled by an action before the movie was open: the Opener
+        // schedules us again when it is done
+        return false;
+    }
+    switch (_stage) {
+        case Stage::Preload:
+            return preloadSome();
+        case Stage::Ready:
+            return process();
+        default:
+            return false;
+    }
+}
+
+bool ofxHap::Demuxer::open()
+{
+    static std::once_flag registerFlag;
+    std::call_once(registerFlag, [](){
+        av_log_set_level(AV_LOG_QUIET);
+        avformat_network_init();
+    });
+    int result = avformat_open_input(&_context, _movie.c_str(), NULL, NULL);
+    if (result == 0)
+    {
+        startupReached(&StartupTimes::opened);
+        MovieMetadata stored;
+        if (!_metadata.empty() && stored.load(_metadata) && stored.apply(_context))
         {
-            result = avformat_find_stream_info(fmt_ctx, NULL);
+            std::lock_guard<std::mutex> guard(_lock);
+            _startup.cachedMetadata = true;
         }
-        if (result == 0)
+        else
         {
-            receiver.foundMovie(fmt_ctx->duration);
-            for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+            result = avformat_find_stream_info(_context, NULL);
+            if (result >= 0 && !_metadata.empty())
+            {
+                stored.capture(_context);
+                stored.save(_metadata);
+            }
+        }
+    }
+    if (result >= 0)
+    {
+        startupReached(&StartupTimes::streamsFound);
+        _receiver.foundMovie(_context->duration);
+        for (unsigned int i = 0; i < _context->nb_streams; i++) {
 #if OFX_HAP_HAS_CODECPAR
-                if (fmt_ctx->streams[i]->codecpar->codec_id == AV_CODEC_ID_HAP && videoStreamIndex == -1)
+            if (_context->streams[i]->codecpar->codec_id == AV_CODEC_ID_HAP && _videoStreamIndex == -1)
 #else
-                if (fmt_ctx->streams[i]->codec->codec_id == AV_CODEC_ID_HAP && videoStreamIndex == -1)
+            if (_context->streams[i]->codec->codec_id == AV_CODEC_ID_HAP && _videoStreamIndex == -1)
 #endif
-                {
-                    videoStreamIndex = i;
-                }
-                else
-                {
-                    fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
-                }
-            }
-
-            if (videoStreamIndex == -1)
             {
-                result = AVERROR_INVALIDDATA;
+                _videoStreamIndex = i;
             }
-
-            if (result >= 0)
+            else
             {
-                receiver.foundStream(fmt_ctx->streams[videoStreamIndex]);
+                _context->streams[i]->discard = AVDISCARD_ALL;
             }
         }
+
+        if (_videoStreamIndex == -1)
+        {
+            result = AVERROR_INVALIDDATA;
+        }
+
         if (result >= 0)
         {
-            result = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
-            if (result >= 0)
+            _receiver.foundStream(_context->streams[_videoStreamIndex]);
+        }
+    }
+    if (result >= 0)
+    {
+        result = av_find_best_stream(_context, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+        if (result >= 0)
+        {
+            _audioStreamIndex = result;
+            _context->streams[_audioStreamIndex]->discard = AVDISCARD_DEFAULT;
+            _receiver.foundStream(_context->streams[_audioStreamIndex]);
+        }
+        result = 0; // Not an error to have no audio
+        // Streams are reported even if we won't read them
+        if (!readsVideo())
+        {
+            _context->streams[_videoStreamIndex]->discard = AVDISCARD_ALL;
+        }
+        if (_audioStreamIndex >= 0 && !readsAudio())
+        {
+            _context->streams[_audioStreamIndex]->discard = AVDISCARD_ALL;
+        }
+    }
+    if (result >= 0)
+    {
+        _packet = av_packet_alloc();
+        if (!_packet)
+        {
+            result = AVERROR(ENOMEM);
+        }
+    }
+    if (result < 0)
+    {
+        _receiver.error(result);
+        _stage = Stage::Done;
+        return false;
+    }
+    if (_preload > 0)
+    {
+        // Only attempt a preload if the file could fit
+        int64_t size = avio_size(_context->pb);
+        if (size > 0 && size <= _preload)
+        {
+            _preloadSize = size;
+            _stage = Stage::Preload;
+            return true;
+        }
+    }
+    return ready();
+}
+
+bool ofxHap::Demuxer::preloadSome()
+{
+    int result = 0;
+    // Read in slices so other movies get a turn
+    for (int i = 0; i < kDemuxerSlicePackets && result >= 0 && _preloadedPackets->getBytes() <= _preload; i++)
+    {
+        _packet->data = NULL;
+        _packet->size = 0;
+        result = av_read_frame(_context, _packet);
+        if (result >= 0)
+        {
+            _preloadedPackets->add(_packet, _context->streams[_packet->stream_index]);
+            av_packet_unref(_packet);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _preloadProgress = std::min(1.0f, avio_tell(_context->pb) / static_cast<float>(_preloadSize));
+        _preloadedBytes = _preloadedPackets->getBytes();
+    }
+    if (result >= 0 && _preloadedPackets->getBytes() <= _preload)
+    {
+        return true;
+    }
+    if (result == AVERROR_EOF)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _preloadProgress = 1.0;
+        _preloaded = true;
+    }
+    else
+    {
+        // Fall back to streaming from the start of the file
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _preloadProgress = 0.0;
+            _preloadedBytes = 0;
+        }
+        _preloadedPackets->clear();
+        result = avformat_seek_file(_context, -1, INT64_MIN, 0, 0, 0);
+        if (result < 0)
+        {
+            _receiver.error(result);
+            _stage = Stage::Done;
+            return false;
+        }
+    }
+    return ready();
+}
+
+bool ofxHap::Demuxer::ready()
+{
+    _receiver.foundAllStreams();
+    startupReached(&StartupTimes::ready);
+    _readahead.reset(new Readahead(_movie));
+    _stage = Stage::Ready;
+    return true;
+}
+
+bool ofxHap::Demuxer::process()
+{
+    // Only hold the lock in this { scope }
+    {
+        std::unique_lock<std::mutex> locker(_lock);
+
+        while (_actions.size() > 0) {
+            const auto action = _actions.front();
+            if (action.kind == Action::Kind::Cancel)
             {
-                audioStreamIndex = result;
-                fmt_ctx->streams[audioStreamIndex]->discard = AVDISCARD_DEFAULT;
-                receiver.foundStream(fmt_ctx->streams[audioStreamIndex]);
+                // empty queued actions
+                _queueStatistics.cancelled += _pending.size();
+                _pending.clear();
+                _urgentLast = false;
             }
-            result = 0; // Not an error to have no audio
+            else if (action.kind == Action::Kind::Prefetch && _preloadedPackets->size() == 0)
+            {
+                // Advised below, so callers aren't held up by the system calls
+                _hints.emplace_back(action.pts, action.length);
+            }
+            else if (action.kind != Action::Kind::Prefetch)
+            {
+                enqueue(action);
+            }
+            _actions.pop();
         }
-        if (result < 0)
+
+        _readStatistics.bytes += _unpublished.bytes;
+        _readStatistics.time += _unpublished.time;
+        _readStatistics.media += _unpublished.media;
+        _unpublished = ReadStatistics();
+
+        _queueStatistics.length = _pending.size();
+        _queueStatistics.peak = std::max(_queueStatistics.peak, _queueStatistics.length);
+
+        if (_pending.size() == 0 && _hints.size() == 0)
         {
-            receiver.error(result);
+            _active = false;
+            return false;
         }
-        else
+    }
+
+    // Hints are cheap, so act on them now rather than waiting behind reads
+    for (const auto& range : _hints)
+    {
+        if (readsVideo())
+        {
+            adviseRange(_context->streams[_videoStreamIndex], range, *_readahead);
+        }
+        if (readsAudio())
         {
-            receiver.foundAllStreams();
+            adviseRange(_context->streams[_audioStreamIndex], range, *_readahead);
+        }
+    }
+    _hints.clear();
 
-            // We have local copies of our member variables so we don't hold the lock
-            // while we do work
-            bool finish = false;
-            std::queue<Action> actions;
-            int64_t lastReadVideo = AV_NOPTS_VALUE;
-            int64_t lastReadAudio = AV_NOPTS_VALUE;
+    for (int i = 0; i < kDemuxerSlicePackets && _pending.size() > 0; i++)
+    {
+        int result = 0;
+        const Action& action = _pending.front();
 
-            AVPacket *packet = av_packet_alloc();
-            
-            while (!finish)
-            {
-                if (actions.size() > 0)
+        switch (action.kind) {
+            case Action::Kind::SeekFrame:
+                if (_preloadedPackets->size() > 0)
                 {
-                    const Action& action = actions.front();
-
-                    switch (action.kind) {
-                        case Action::Kind::SeekFrame:
-                            result = avformat_seek_file(fmt_ctx, videoStreamIndex, INT64_MIN, action.pts, action.pts, AVSEEK_FLAG_FRAME);
-                            lastReadAudio = lastReadVideo = AV_NOPTS_VALUE;
-                            receiver.discontinuity();
-                            break;
-                        case Action::Kind::SeekTime:
-                            result = avformat_seek_file(fmt_ctx, -1, INT64_MIN, action.pts, action.pts, 0);
-                            lastReadAudio = lastReadVideo = AV_NOPTS_VALUE;
-                            receiver.discontinuity();
-                            break;
-                        case Action::Kind::Read:
-                            if ((lastReadVideo == AV_NOPTS_VALUE || lastReadVideo < action.pts) ||
-                                (audioStreamIndex >= 0 && (lastReadAudio == AV_NOPTS_VALUE || lastReadAudio < action.pts)))
-                            {
-                                packet->data = NULL;
-                                packet->size = 0;
-                                result = av_read_frame(fmt_ctx, packet);
-                                if (result >= 0)
-                                {
-                                    receiver.readPacket(packet);
-                                    if (packet->stream_index == videoStreamIndex)
-                                    {
-                                        lastReadVideo = av_rescale_q(packet->pts + packet->duration - 1,
-                                                                     fmt_ctx->streams[videoStreamIndex]->time_base, { 1, AV_TIME_BASE });
-                                    }
-                                    else if (packet->stream_index == audioStreamIndex)
-                                    {
-                                        lastReadAudio = av_rescale_q(packet->pts + packet->duration - 1,
-                                                                     fmt_ctx->streams[audioStreamIndex]->time_base, { 1, AV_TIME_BASE });
-                                    }
-                                }
-                                else if (result == AVERROR_EOF)
-                                {
-                                    receiver.endMovie();
-                                }
-                                av_packet_unref(packet);
-                            }
-                            break;
-                        default:
-                            break;
+                    _next = _preloadedPackets->seekFrame(action.pts, _videoStreamIndex);
+                }
+                else
+                {
+                    result = avformat_seek_file(_context, _videoStreamIndex, INT64_MIN, action.pts, action.pts, AVSEEK_FLAG_FRAME);
+                }
+                _lastReadAudio = _lastReadVideo = AV_NOPTS_VALUE;
+                deliver();
+                _receiver.discontinuity();
+                break;
+            case Action::Kind::SeekTime:
+                if (_preloadedPackets->size() > 0)
+                {
+                    _next = _preloadedPackets->seekTime(action.pts);
+                }
+                else
+                {
+                    result = avformat_seek_file(_context, -1, INT64_MIN, action.pts, action.pts, 0);
+                }
+                _lastReadAudio = _lastReadVideo = AV_NOPTS_VALUE;
+                deliver();
+                _receiver.discontinuity();
+                break;
+            case Action::Kind::Read:
+                if ((readsVideo() && (_lastReadVideo == AV_NOPTS_VALUE || _lastReadVideo < action.pts)) ||
+                    (readsAudio() && (_lastReadAudio == AV_NOPTS_VALUE || _lastReadAudio < action.pts)))
+                {
+                    AVPacket *packet = batchPacket();
+                    if (!packet)
+                    {
+                        result = AVERROR(ENOMEM);
                     }
-
-                    if (action.kind != Action::Kind::Read ||
-                        result < 0 ||
-                        (lastReadVideo >= action.pts && (audioStreamIndex == -1 || lastReadAudio >= action.pts)))
+                    else if (_preloadedPackets->size() > 0)
                     {
-                        actions.pop();
+                        result = _next < _preloadedPackets->size() ? av_packet_ref(packet, _preloadedPackets->at(_next++)) : AVERROR_EOF;
                     }
-
-                    if (result < 0 && result != AVERROR_EOF)
+                    else
                     {
-                        receiver.error(result);
+                        int64_t start = av_gettime_relative();
+                        result = av_read_frame(_context, packet);
+                        _unpublished.time += av_gettime_relative() - start;
                     }
-                }
-
-                // Only hold the lock in this { scope }
-                {
-                    std::unique_lock<std::mutex> locker(_lock);
-
-                    finish = _finish;
-
-                    while (_actions.size() > 0) {
-                        const auto action = _actions.front();
-                        if (action.kind == Action::Kind::Cancel)
+                    if (result >= 0)
+                    {
+                        _unpublished.bytes += packet->size;
+                        // Packets are passed on together, unless they are large enough that
+                        // holding them back would delay playback
+                        _batch.push_back(packet);
+                        _batchBytes += packet->size;
+                        if (_batchBytes >= kDemuxerBatchBytes)
                         {
-                            // empty queued actions
-                            std::queue<Action>().swap(actions);
+                            deliver();
                         }
-                        else
+                        if (packet->stream_index == _videoStreamIndex)
                         {
-                            actions.push(action);
+                            _unpublished.media += av_rescale_q(packet->duration, _context->streams[_videoStreamIndex]->time_base, { 1, AV_TIME_BASE });
+                            _lastReadVideo = av_rescale_q(packet->pts + packet->duration - 1,
+                                                          _context->streams[_videoStreamIndex]->time_base, { 1, AV_TIME_BASE });
+                        }
+                        else if (packet->stream_index == _audioStreamIndex)
+                        {
+                            if (!readsVideo())
+                            {
+                                _unpublished.media += av_rescale_q(packet->duration, _context->streams[_audioStreamIndex]->time_base, { 1, AV_TIME_BASE });
+                            }
+                            _lastReadAudio = av_rescale_q(packet->pts + packet->duration - 1,
+                                                          _context->streams[_audioStreamIndex]->time_base, { 1, AV_TIME_BASE });
                         }
-                        _actions.pop();
                     }
-
-                    result = 0;
-
-                    if (actions.size() == 0)
+                    else
                     {
-                        _active = false;
-                        if (finish == false)
+                        if (packet)
+                        {
+                            _spare.push_back(packet);
+                        }
+                        if (result == AVERROR_EOF)
                         {
-                            _condition.wait(locker);
+                            deliver();
+                            _receiver.endMovie();
                         }
                     }
                 }
-            }
-            av_packet_free(&packet);
+                break;
+            default:
+                break;
+        }
+
+        if (action.kind != Action::Kind::Read ||
+            result < 0 ||
+            ((!readsVideo() || _lastReadVideo >= action.pts) && (!readsAudio() || _lastReadAudio >= action.pts)))
+        {
+            _pending.pop_front();
+        }
+
+        if (result < 0 && result != AVERROR_EOF)
+        {
+            _receiver.error(result);
+        }
+    }
+    deliver();
+    // Run again to pick up new actions, or to mark ourself inactive
+    return true;
+}
+
+bool ofxHap::Demuxer::readsVideo() const
+{
+    return _streams != Streams::Audio;
+}
+
+bool ofxHap::Demuxer::readsAudio() const
+{
+    return _audioStreamIndex >= 0 && _streams != Streams::Video;
+}
+
+AVPacket *ofxHap::Demuxer::batchPacket()
+{
+    if (_spare.size() > 0)
+    {
+        AVPacket *packet = _spare.back();
+        _spare.pop_back();
+        return packet;
+    }
+    return av_packet_alloc();
+}
+
+void ofxHap::Demuxer::deliver()
+{
+    if (_batch.size() > 0)
+    {
+        _receiver.readPackets(_batch);
+        for (auto packet : _batch)
+        {
+            av_packet_unref(packet);
+            _spare.push_back(packet);
         }
+        _batch.clear();
+        _batchBytes = 0;
+    }
+}
 
-        if (fmt_ctx)
+void ofxHap::Demuxer::enqueue(const Action& action)
+{
+    auto isSeek = [](const Action& a) {
+        return a.kind == Action::Kind::SeekTime || a.kind == Action::Kind::SeekFrame;
+    };
+    // Urgent work goes ahead of the first seek which isn't urgent, after any other urgent
+    // work. A read can only go with the action queued before it, as it continues from there
+    auto position = _pending.end();
+    bool urgent = action.urgent && (isSeek(action) || _urgentLast);
+    if (urgent)
+    {
+        position = std::find_if(_pending.begin(), _pending.end(), [&](const Action& a) {
+            return isSeek(a) && !a.urgent;
+        });
+    }
+    _urgentLast = urgent;
+    if (position != _pending.begin())
+    {
+        Action& previous = *std::prev(position);
+        if (action.kind == Action::Kind::Read && previous.kind == Action::Kind::Read)
+        {
+            // Reads continue from wherever the previous one finished, so one read covers both
+            previous.pts = std::max(previous.pts, action.pts);
+            _queueStatistics.merged++;
+            return;
+        }
+        if (isSeek(action) && isSeek(previous))
         {
-            avformat_close_input(&fmt_ctx);
+            // Nothing will be read from the earlier position. Reads queued after an earlier
+            // seek are kept, as a player queues several ranges at once
+            previous = action;
+            previous.urgent = urgent;
+            _queueStatistics.merged++;
+            return;
         }
     }
+    Action queued = action;
+    queued.urgent = urgent;
+    _pending.insert(position, queued);
 }
 
-void ofxHap::Demuxer::read(int64_t pts)
+void ofxHap::Demuxer::read(int64_t pts, bool urgent)
 {
     std::unique_lock<std::mutex> locker(_lock);
     _lastRead = pts;
-    _actions.emplace(Action::Kind::Read, pts);
+    _actions.emplace(Action::Kind::Read, pts, 0, urgent);
     _active = true;
-    _condition.notify_one();
+    _pool->schedule(this);
 }
 
-void ofxHap::Demuxer::seekTime(int64_t time)
+void ofxHap::Demuxer::seekTime(int64_t time, bool urgent)
 {
     std::unique_lock<std::mutex> locker(_lock);
     _lastSeek = time;
     _lastRead = AV_NOPTS_VALUE;
-    _actions.emplace(Action::Kind::SeekTime, time);
+    _actions.emplace(Action::Kind::SeekTime, time, 0, urgent);
     _active = true;
-    _condition.notify_one();
+    _pool->schedule(this);
 }
 
 void ofxHap::Demuxer::seekFrame(int64_t frame)
@@ -251,14 +676,71 @@ void ofxHap::Demuxer::seekFrame(int64_t frame)
     std::unique_lock<std::mutex> locker(_lock);
     _actions.emplace(Action::Kind::SeekFrame, frame);
     _active = true;
-    _condition.notify_one();
+    _pool->schedule(this);
+}
+
+void ofxHap::Demuxer::prefetch(const TimeRange& range)
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    _actions.emplace(Action::Kind::Prefetch, range.earliest(), std::abs(range.length));
+    _pool->schedule(this);
 }
 
 void ofxHap::Demuxer::cancel()
 {
     std::unique_lock<std::mutex> locker(_lock);
+    // Drop anything not yet seen by the task, and have it drop what it already has
+    _queueStatistics.cancelled += _actions.size();
+    std::queue<Action>().swap(_actions);
+    // Our position is unknown until the next seek
+    _lastRead = AV_NOPTS_VALUE;
     _actions.emplace(Action::Kind::Cancel, 0);
-    _condition.notify_one();
+    _pool->schedule(this);
+}
+
+float ofxHap::Demuxer::getPreloadProgress() const
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    return _preloadProgress;
+}
+
+bool ofxHap::Demuxer::isPreloaded() const
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    return _preloaded;
+}
+
+int64_t ofxHap::Demuxer::getPreloadedBytes() const
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    return _preloadedBytes;
+}
+
+ofxHap::Demuxer::QueueStatistics ofxHap::Demuxer::getQueueStatistics() const
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    QueueStatistics statistics = _queueStatistics;
+    statistics.length += _actions.size();
+    return statistics;
+}
+
+ofxHap::Demuxer::ReadStatistics ofxHap::Demuxer::getReadStatistics() const
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    return _readStatistics;
+}
+
+ofxHap::Demuxer::StartupTimes ofxHap::Demuxer::getStartupTimes() const
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    return _startup;
+}
+
+void ofxHap::Demuxer::startupReached(int64_t StartupTimes::*stage)
+{
+    int64_t now = av_gettime_relative();
+    std::unique_lock<std::mutex> locker(_lock);
+    _startup.*stage = now - _created;
 }
 
 int64_t ofxHap::Demuxer::getLastReadTime() const
@@ -277,8 +759,26 @@ bool ofxHap::Demuxer::isActive() const
     return _active;
 }
 
-ofxHap::Demuxer::Action::Action(Kind k, int64_t p)
-: kind(k), pts(p)
+ofxHap::Demuxer::Action::Action(Kind k, int64_t p, int64_t l, bool u)
+: kind(k), pts(p), length(l), urgent(u)
+{
+
+}
+
+ofxHap::Demuxer::StartupTimes::StartupTimes()
+: opened(AV_NOPTS_VALUE), streamsFound(AV_NOPTS_VALUE), ready(AV_NOPTS_VALUE), cachedMetadata(false)
+{
+
+}
+
+ofxHap::Demuxer::QueueStatistics::QueueStatistics()
+: length(0), peak(0), merged(0), cancelled(0)
+{
+
+}
+
+ofxHap::Demuxer::ReadStatistics::ReadStatistics()
+: bytes(0), time(0), media(0)
 {
 
 }
@@ -0,0 +1,89 @@
+/*
+ FileIdentity.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/FileIdentity.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+
+ofxHap::FileIdentity::FileIdentity(const std::string& path)
+: _path(path), _size(-1), _modified(0)
+{
+    if (path.find("://") == std::string::npos)
+    {
+#if defined(_WIN32)
+        struct _stat64 info;
+        if (_stat64(path.c_str(), &info) == 0)
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0)
+#endif
+        {
+            _size = info.st_size;
+            _modified = info.st_mtime;
+        }
+    }
+}
+
+bool ofxHap::FileIdentity::isValid() const
+{
+    return _size >= 0;
+}
+
+std::string ofxHap::FileIdentity::getKey() const
+{
+    // FNV-1a, which unlike std::hash is stable between runs and builds
+    uint64_t hash = UINT64_C(14695981039346656037);
+    auto add = [&hash](const void *data, size_t length) {
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= static_cast<const unsigned char *>(data)[i];
+            hash *= UINT64_C(1099511628211);
+        }
+    };
+    add(_path.data(), _path.length());
+    add(&_size, sizeof(_size));
+    add(&_modified, sizeof(_modified));
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+    return key;
+}
+
+int64_t ofxHap::FileIdentity::getSize() const
+{
+    return _size;
+}
+
+bool ofxHap::FileIdentity::operator==(const FileIdentity& o) const
+{
+    return _path == o._path && _size == o._size && _modified == o._modified;
+}
+
+bool ofxHap::FileIdentity::operator!=(const FileIdentity& o) const
+{
+    return !(*this == o);
+}
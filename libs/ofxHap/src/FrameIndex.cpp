@@ -0,0 +1,133 @@
+/*
+ FrameIndex.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/FrameIndex.h>
+#include <ofxHap/Common.h>
+extern "C" {
+#include <libavformat/avformat.h>
+}
+#include <algorithm>
+
+ofxHap::FrameIndex::FrameIndex()
+{
+
+}
+
+void ofxHap::FrameIndex::build(AVStream *stream)
+{
+    _entries.clear();
+#if OFX_HAP_HAS_INDEX_ENTRY_API
+    int count = avformat_index_get_entries_count(stream);
+#else
+    int count = stream->nb_index_entries;
+#endif
+    _entries.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+#if OFX_HAP_HAS_INDEX_ENTRY_API
+        const AVIndexEntry *entry = avformat_index_get_entry(stream, i);
+#else
+        const AVIndexEntry *entry = &stream->index_entries[i];
+#endif
+#ifdef AVINDEX_DISCARD_FRAME
+        // Frames outside an edit list are never presented
+        if (entry->flags & AVINDEX_DISCARD_FRAME)
+        {
+            continue;
+        }
+#endif
+        // Hap frames are all keyframes and aren't reordered, so index
+        // timestamps are presentation times
+        _entries.push_back({ entry->timestamp, 0, entry->pos });
+    }
+    std::sort(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b) {
+        return a.pts < b.pts;
+    });
+    for (size_t i = 0; i + 1 < _entries.size(); i++)
+    {
+        _entries[i].duration = _entries[i + 1].pts - _entries[i].pts;
+    }
+    if (_entries.size() > 0)
+    {
+        Entry& last = _entries.back();
+        int64_t start = stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time;
+        if (stream->duration != AV_NOPTS_VALUE && start + stream->duration > last.pts)
+        {
+            last.duration = start + stream->duration - last.pts;
+        }
+        else if (_entries.size() > 1)
+        {
+            last.duration = _entries[_entries.size() - 2].duration;
+        }
+        else
+        {
+            last.duration = 1;
+        }
+    }
+}
+
+void ofxHap::FrameIndex::clear()
+{
+    _entries.clear();
+}
+
+bool ofxHap::FrameIndex::isValid() const
+{
+    return _entries.size() > 0;
+}
+
+int64_t ofxHap::FrameIndex::size() const
+{
+    return _entries.size();
+}
+
+int64_t ofxHap::FrameIndex::getFrame(int64_t pts) const
+{
+    auto it = std::upper_bound(_entries.begin(), _entries.end(), pts, [](int64_t p, const Entry& e) {
+        return p < e.pts;
+    });
+    if (it == _entries.begin())
+    {
+        return 0;
+    }
+    return std::distance(_entries.begin(), it) - 1;
+}
+
+int64_t ofxHap::FrameIndex::getTime(int64_t frame) const
+{
+    return _entries[frame].pts;
+}
+
+int64_t ofxHap::FrameIndex::getDuration(int64_t frame) const
+{
+    return _entries[frame].duration;
+}
+
+int64_t ofxHap::FrameIndex::getPosition(int64_t frame) const
+{
+    return _entries[frame].position;
+}
@@ -0,0 +1,452 @@
+/*
+ MappedFrameCache.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/MappedFrameCache.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+namespace ofxHap {
+    static const char kMappedFrameCacheMagic[8] = { 'o', 'f', 'x', 'H', 'a', 'p', 'F', 'C' };
+    static const uint32_t kMappedFrameCacheVersion = 1;
+    static const size_t kMappedFrameCacheAlignment = 4096;
+    // Frames are flushed to disk and recorded in batches of this many
+    static const uint64_t kMappedFrameCacheFlushFrames = 16;
+
+    class CacheFile {
+    public:
+        std::string path;
+        int64_t     size;
+        int64_t     used; // last modified, in seconds
+    };
+
+    // Other files with the same extension in the same directory as path
+    static std::vector<CacheFile> cacheFiles(const std::string& path)
+    {
+        std::vector<CacheFile> files;
+        size_t separator = path.find_last_of("/\\");
+        std::string directory = separator == std::string::npos ? "." : path.substr(0, separator);
+        std::string name = separator == std::string::npos ? path : path.substr(separator + 1);
+        size_t dot = name.find_last_of('.');
+        std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+#if defined(_WIN32)
+        WIN32_FIND_DATAA found;
+        HANDLE find = FindFirstFileA((directory + "\\*" + extension).c_str(), &found);
+        if (find != INVALID_HANDLE_VALUE)
+        {
+            do {
+                if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && name != found.cFileName)
+                {
+                    ULARGE_INTEGER time;
+                    time.LowPart = found.ftLastWriteTime.dwLowDateTime;
+                    time.HighPart = found.ftLastWriteTime.dwHighDateTime;
+                    files.push_back({ directory + "\\" + found.cFileName,
+                        static_cast<int64_t>((static_cast<uint64_t>(found.nFileSizeHigh) << 32) | found.nFileSizeLow),
+                        static_cast<int64_t>(time.QuadPart / 10000000) });
+                }
+            } while (FindNextFileA(find, &found));
+            FindClose(find);
+        }
+#else
+        DIR *dir = opendir(directory.c_str());
+        if (dir)
+        {
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != nullptr)
+            {
+                std::string file = entry->d_name;
+                if (file != name && file.length() > extension.length() &&
+                    file.compare(file.length() - extension.length(), extension.length(), extension) == 0)
+                {
+                    struct stat info;
+                    std::string full = directory + "/" + file;
+                    if (stat(full.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+                    {
+                        files.push_back({ full, static_cast<int64_t>(info.st_size), static_cast<int64_t>(info.st_mtime) });
+                    }
+                }
+            }
+            closedir(dir);
+        }
+#endif
+        return files;
+    }
+
+    // Delete a cache file unless another cache has it open
+    static bool removeCacheFile(const std::string& path)
+    {
+#if defined(_WIN32)
+        // Fails if the file is open
+        return DeleteFileA(path.c_str()) != 0;
+#else
+        int file = ::open(path.c_str(), O_RDWR);
+        if (file == -1)
+        {
+            return false;
+        }
+        bool removed = flock(file, LOCK_EX | LOCK_NB) == 0 && unlink(path.c_str()) == 0;
+        ::close(file);
+        return removed;
+#endif
+    }
+
+    // Delete the least recently used files beside path until length more bytes fit within limit
+    static bool makeSpace(const std::string& path, int64_t length, int64_t limit)
+    {
+        if (length > limit)
+        {
+            return false;
+        }
+        std::vector<CacheFile> files = cacheFiles(path);
+        int64_t total = length;
+        for (const auto& file : files)
+        {
+            total += file.size;
+        }
+        std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) {
+            return a.used < b.used;
+        });
+        for (auto itr = files.begin(); itr != files.end() && total > limit; ++itr)
+        {
+            if (removeCacheFile(itr->path))
+            {
+                total -= itr->size;
+            }
+        }
+        return total <= limit;
+    }
+}
+
+std::shared_ptr<ofxHap::MappedFrameCache> ofxHap::MappedFrameCache::open(const std::string& path, size_t frameSize, int64_t frameCount, uint32_t format, int64_t limit)
+{
+    static std::mutex lock;
+    static std::map<std::string, std::weak_ptr<MappedFrameCache>> caches;
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<MappedFrameCache> cache = caches[path].lock();
+    if (cache)
+    {
+        // Another player is using this cache - we can only share it if the layout matches
+        if (cache->_frameSize != frameSize || cache->_frameCount != frameCount)
+        {
+            cache.reset();
+        }
+    }
+    else if (frameSize > 0 && frameCount > 0 && makeSpace(path, static_cast<int64_t>(dataOffset(frameCount) + (frameSize * frameCount)), limit))
+    {
+        cache = std::shared_ptr<MappedFrameCache>(new MappedFrameCache(path, frameSize, frameCount, format));
+        if (cache->_data)
+        {
+            caches[path] = cache;
+        }
+        else
+        {
+            cache.reset();
+        }
+    }
+    return cache;
+}
+
+ofxHap::MappedFrameCache::MappedFrameCache(const std::string& path, size_t frameSize, int64_t frameCount, uint32_t format)
+: _path(path), _frameSize(frameSize), _frameCount(frameCount), _complete(0), _published(0), _pool(DemuxPool::opening()), _data(nullptr), _length(0),
+#if defined(_WIN32)
+_file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+#else
+_file(-1)
+#endif
+{
+    _dataOffset = dataOffset(frameCount);
+    size_t length = _dataOffset + (frameSize * frameCount);
+
+    if (map(length))
+    {
+        Header *header = reinterpret_cast<Header *>(_data);
+        if (memcmp(header->magic, kMappedFrameCacheMagic, sizeof(header->magic)) == 0 &&
+            header->version == kMappedFrameCacheVersion &&
+            header->format == format &&
+            header->frameSize == frameSize &&
+            header->frameCount == static_cast<uint64_t>(frameCount) &&
+            header->used <= static_cast<uint64_t>(frameCount))
+        {
+            const Entry *entries = reinterpret_cast<const Entry *>(_data + sizeof(Header));
+            for (uint64_t i = 0; i < header->used; i++)
+            {
+                _slots[entries[i].pts] = { entries[i].duration, i, true };
+            }
+            _complete = _published = header->used;
+        }
+        else
+        {
+            // New or incompatible - start again
+            memcpy(header->magic, kMappedFrameCacheMagic, sizeof(header->magic));
+            header->version = kMappedFrameCacheVersion;
+            header->format = format;
+            header->frameSize = frameSize;
+            header->frameCount = frameCount;
+            header->used = 0;
+        }
+    }
+}
+
+size_t ofxHap::MappedFrameCache::dataOffset(int64_t frameCount)
+{
+    // Frames follow the header and table, aligned to a page
+    size_t table = sizeof(Header) + (sizeof(Entry) * frameCount);
+    return ((table + kMappedFrameCacheAlignment - 1) / kMappedFrameCacheAlignment) * kMappedFrameCacheAlignment;
+}
+
+ofxHap::MappedFrameCache::~MappedFrameCache()
+{
+    _pool->remove(this);
+    if (_data)
+    {
+        flush();
+    }
+    unmap();
+}
+
+bool ofxHap::MappedFrameCache::run()
+{
+    flush();
+    return false;
+}
+
+void ofxHap::MappedFrameCache::flush()
+{
+    uint64_t first;
+    uint64_t last;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        first = _published;
+        last = _complete;
+    }
+    if (last > first)
+    {
+        // Frames and their entries must be on disk before the header counts them. Frames
+        // from last on may still be being copied, and are counted by a later flush
+        sync(0, _dataOffset);
+        sync(_dataOffset + (first * _frameSize), (last - first) * _frameSize);
+        std::lock_guard<std::mutex> guard(_lock);
+        reinterpret_cast<Header *>(_data)->used = last;
+        _published = last;
+    }
+}
+
+void ofxHap::MappedFrameCache::sync(size_t offset, size_t length)
+{
+#if defined(_WIN32)
+    FlushViewOfFile(_data + offset, length);
+    FlushFileBuffers(_file);
+#else
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = (offset / page) * page;
+    msync(_data + start, offset + length - start, MS_SYNC);
+#endif
+}
+
+bool ofxHap::MappedFrameCache::map(size_t length)
+{
+#if defined(_WIN32)
+    _file = CreateFileA(_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    // Another process using the file would see it change beneath it
+    OVERLAPPED overlapped = {};
+    if (!LockFileEx(_file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &overlapped))
+    {
+        unmap();
+        return false;
+    }
+    // Mark the file as recently used
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(_file, NULL, NULL, &now);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || static_cast<size_t>(size.QuadPart) != length)
+    {
+        // Discard any previous content, which can't be for this layout
+        LARGE_INTEGER zero;
+        zero.QuadPart = 0;
+        size.QuadPart = length;
+        if (!SetFilePointerEx(_file, zero, NULL, FILE_BEGIN) || !SetEndOfFile(_file) ||
+            !SetFilePointerEx(_file, size, NULL, FILE_BEGIN) || !SetEndOfFile(_file))
+        {
+            unmap();
+            return false;
+        }
+    }
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(length) >> 32), static_cast<DWORD>(length & 0xFFFFFFFF), NULL);
+    if (_mapping)
+    {
+        _data = static_cast<char *>(MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, length));
+    }
+#else
+    _file = ::open(_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (_file == -1)
+    {
+        return false;
+    }
+    // Another process using the file would see it change beneath it, and could
+    // fault if it was truncated
+    if (flock(_file, LOCK_EX | LOCK_NB) != 0)
+    {
+        unmap();
+        return false;
+    }
+    // Mark the file as recently used
+    futimens(_file, nullptr);
+    struct stat info;
+    if (fstat(_file, &info) != 0 || static_cast<size_t>(info.st_size) != length)
+    {
+        // Discard any previous content, which can't be for this layout
+        // The file is sparse until frames are written
+        if (ftruncate(_file, 0) != 0 || ftruncate(_file, length) != 0)
+        {
+            unmap();
+            return false;
+        }
+    }
+    void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0);
+    if (data != MAP_FAILED)
+    {
+        _data = static_cast<char *>(data);
+    }
+#endif
+    if (_data)
+    {
+        _length = length;
+        return true;
+    }
+    unmap();
+    return false;
+}
+
+void ofxHap::MappedFrameCache::unmap()
+{
+#if defined(_WIN32)
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_file);
+    }
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+#else
+    if (_data)
+    {
+        munmap(_data, _length);
+    }
+    if (_file != -1)
+    {
+        ::close(_file);
+    }
+    _file = -1;
+#endif
+    _data = nullptr;
+    _length = 0;
+}
+
+size_t ofxHap::MappedFrameCache::getFrameSize() const
+{
+    return _frameSize;
+}
+
+const char *ofxHap::MappedFrameCache::fetch(int64_t pts, int64_t& start, int64_t& duration) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    auto itr = _slots.upper_bound(pts);
+    if (itr != _slots.begin())
+    {
+        --itr;
+        if (itr->second.written && pts < itr->first + itr->second.duration)
+        {
+            start = itr->first;
+            duration = itr->second.duration;
+            return _data + _dataOffset + (itr->second.index * _frameSize);
+        }
+    }
+    return nullptr;
+}
+
+void ofxHap::MappedFrameCache::store(int64_t pts, int64_t duration, const char *data)
+{
+    // Take a slot, then copy the frame in without the lock, so fetches by other
+    // players of the movie don't wait on the copy
+    uint64_t index;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_slots.size() >= static_cast<uint64_t>(_frameCount) || _slots.find(pts) != _slots.end())
+        {
+            return;
+        }
+        index = _slots.size();
+        _slots[pts] = { duration, index, false };
+    }
+    memcpy(_data + _dataOffset + (index * _frameSize), data, _frameSize);
+    std::lock_guard<std::mutex> guard(_lock);
+    Entry *entries = reinterpret_cast<Entry *>(_data + sizeof(Header));
+    entries[index].pts = pts;
+    entries[index].duration = duration;
+    _slots[pts].written = true;
+    if (_written.size() <= index)
+    {
+        _written.resize(index + 1);
+    }
+    _written[index] = true;
+    // Copies may finish out of order, and the file can only count a run of written frames
+    while (_complete < _written.size() && _written[_complete])
+    {
+        _complete++;
+    }
+    // The file only counts the frame once it has been flushed
+    if (_complete - _published >= kMappedFrameCacheFlushFrames)
+    {
+        _pool->schedule(this);
+    }
+}
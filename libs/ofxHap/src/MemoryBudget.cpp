@@ -0,0 +1,307 @@
+/*
+ MemoryBudget.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <ofxHap/MemoryBudget.h>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace ofxHap {
+    static const std::chrono::milliseconds kBalanceInterval(250);
+    static const std::chrono::milliseconds kPollInterval(1000);
+    // Keep this much of the system's memory free, at least
+    static const int64_t kMinimumReserve = INT64_C(268435456);
+    // Treat memory as short once tasks stall on it for this % of the time
+    static const double kPressureThreshold = 10.0;
+    // Below this a client is shrunk to nothing
+    static const float kMinimumScale = 1.0f / 16.0f;
+
+#if defined(__linux__)
+    static bool readMemoryInfo(int64_t& total, int64_t& available)
+    {
+        std::ifstream file("/proc/meminfo");
+        std::string line;
+        total = available = -1;
+        while (std::getline(file, line) && (total < 0 || available < 0))
+        {
+            std::istringstream fields(line);
+            std::string name;
+            int64_t kb;
+            if (fields >> name >> kb)
+            {
+                if (name == "MemTotal:")
+                    total = kb * 1024;
+                else if (name == "MemAvailable:")
+                    available = kb * 1024;
+            }
+        }
+        return total >= 0 && available >= 0;
+    }
+
+    static bool readPressure(double& average)
+    {
+        // eg "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+        std::ifstream file("/proc/pressure/memory");
+        std::string kind;
+        std::string field;
+        if (file >> kind >> field && kind == "some" && field.compare(0, 6, "avg10=") == 0)
+        {
+            average = std::strtod(field.c_str() + 6, nullptr);
+            return true;
+        }
+        return false;
+    }
+#endif
+}
+
+ofxHap::MemoryBudget::Client::Client(std::shared_ptr<MemoryBudget> budget)
+: _budget(budget), _priority(0), _usage(), _scale(1.0f)
+{
+    _budget->add(this);
+}
+
+ofxHap::MemoryBudget::Client::~Client()
+{
+    _budget->remove(this);
+}
+
+void ofxHap::MemoryBudget::Client::setPriority(int priority)
+{
+    std::lock_guard<std::mutex> guard(_budget->_lock);
+    _priority = priority;
+}
+
+int ofxHap::MemoryBudget::Client::getPriority() const
+{
+    std::lock_guard<std::mutex> guard(_budget->_lock);
+    return _priority;
+}
+
+void ofxHap::MemoryBudget::Client::setUsage(Tier tier, int64_t bytes)
+{
+    std::lock_guard<std::mutex> guard(_budget->_lock);
+    _usage[static_cast<int>(tier)] = bytes;
+    if (std::chrono::steady_clock::now() - _budget->_lastBalance >= kBalanceInterval)
+    {
+        _budget->balance();
+    }
+}
+
+void ofxHap::MemoryBudget::Client::setUsage(const int64_t (&bytes)[kTierCount])
+{
+    std::lock_guard<std::mutex> guard(_budget->_lock);
+    std::copy(std::begin(bytes), std::end(bytes), _usage);
+    if (std::chrono::steady_clock::now() - _budget->_lastBalance >= kBalanceInterval)
+    {
+        _budget->balance();
+    }
+}
+
+int64_t ofxHap::MemoryBudget::Client::getUsage(Tier tier) const
+{
+    std::lock_guard<std::mutex> guard(_budget->_lock);
+    return _usage[static_cast<int>(tier)];
+}
+
+int64_t ofxHap::MemoryBudget::Client::getUsage() const
+{
+    std::lock_guard<std::mutex> guard(_budget->_lock);
+    int64_t total = 0;
+    for (int64_t usage : _usage)
+    {
+        total += usage;
+    }
+    return total;
+}
+
+float ofxHap::MemoryBudget::Client::getScale() const
+{
+    std::lock_guard<std::mutex> guard(_budget->_lock);
+    return _scale;
+}
+
+std::shared_ptr<ofxHap::MemoryBudget> ofxHap::MemoryBudget::shared()
+{
+    static std::shared_ptr<MemoryBudget> budget = std::make_shared<MemoryBudget>();
+    return budget;
+}
+
+ofxHap::MemoryBudget::MemoryBudget()
+: _pool(DemuxPool::opening()), _limit(0), _available(-1), _pressured(false)
+{
+    _pool->schedule(this);
+}
+
+ofxHap::MemoryBudget::~MemoryBudget()
+{
+    _pool->remove(this);
+}
+
+void ofxHap::MemoryBudget::setLimit(int64_t bytes)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _limit = bytes;
+    balance();
+}
+
+int64_t ofxHap::MemoryBudget::getLimit() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _limit;
+}
+
+int64_t ofxHap::MemoryBudget::getUsage() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return getUsageLocked();
+}
+
+int64_t ofxHap::MemoryBudget::getUsage(Tier tier) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    int64_t total = 0;
+    for (const Client *client : _clients)
+    {
+        total += client->_usage[static_cast<int>(tier)];
+    }
+    return total;
+}
+
+bool ofxHap::MemoryBudget::isPressured() const
+{
+    return _pressured;
+}
+
+void ofxHap::MemoryBudget::add(Client *client)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _clients.push_back(client);
+}
+
+void ofxHap::MemoryBudget::remove(Client *client)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _clients.erase(std::remove(_clients.begin(), _clients.end(), client), _clients.end());
+}
+
+int64_t ofxHap::MemoryBudget::getUsageLocked() const
+{
+    int64_t total = 0;
+    for (const Client *client : _clients)
+    {
+        for (int64_t usage : client->_usage)
+        {
+            total += usage;
+        }
+    }
+    return total;
+}
+
+bool ofxHap::MemoryBudget::run()
+{
+#if defined(__linux__)
+    int64_t spare = -1;
+    bool pressured = false;
+    int64_t total;
+    int64_t available;
+    if (readMemoryInfo(total, available))
+    {
+        int64_t reserve = std::max(kMinimumReserve, total / 10);
+        spare = available - reserve;
+        pressured = spare < 0;
+    }
+    double average;
+    if (readPressure(average) && average >= kPressureThreshold)
+    {
+        pressured = true;
+    }
+    _available = spare;
+    _pressured = pressured;
+    _pool->schedule(this, kPollInterval);
+#endif
+    return false;
+}
+
+void ofxHap::MemoryBudget::balance()
+{
+    _lastBalance = std::chrono::steady_clock::now();
+    if (_clients.empty())
+    {
+        return;
+    }
+    // Read once, as the poll may publish new values as we go
+    int64_t spare = _available;
+    bool pressured = _pressured;
+    int64_t usage = getUsageLocked();
+    int64_t ceiling = std::numeric_limits<int64_t>::max();
+    if (_limit > 0)
+    {
+        ceiling = _limit;
+    }
+    if (spare != -1)
+    {
+        ceiling = std::min(ceiling, usage + spare);
+    }
+    if (pressured)
+    {
+        // The system may be short of memory for reasons other than our usage, so give some back
+        ceiling = std::min(ceiling, usage - usage / 4);
+    }
+    // Shrink or grow a priority level at a time, then wait for clients to adjust
+    // before looking again
+    if (usage > ceiling)
+    {
+        int lowest = std::numeric_limits<int>::max();
+        for (const Client *client : _clients)
+        {
+            if (client->_scale > 0.0f)
+                lowest = std::min(lowest, client->_priority);
+        }
+        for (Client *client : _clients)
+        {
+            if (client->_priority == lowest)
+                client->_scale = client->_scale > kMinimumScale ? client->_scale / 2.0f : 0.0f;
+        }
+    }
+    else if (usage < ceiling - ceiling / 8 && !pressured)
+    {
+        int highest = std::numeric_limits<int>::min();
+        for (const Client *client : _clients)
+        {
+            if (client->_scale < 1.0f)
+                highest = std::max(highest, client->_priority);
+        }
+        for (Client *client : _clients)
+        {
+            if (client->_priority == highest)
+                client->_scale = client->_scale > 0.0f ? std::min(1.0f, client->_scale * 1.5f) : kMinimumScale;
+        }
+    }
+}
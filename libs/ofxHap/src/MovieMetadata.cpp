@@ -0,0 +1,237 @@
+/*
+ MovieMetadata.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/MovieMetadata.h>
+#include <ofxHap/Common.h>
+extern "C" {
+#include <libavformat/avformat.h>
+}
+#include <fstream>
+#include <cstdio>
+#include <thread>
+
+#define kofxHapMetadataSignature "ofxHapMetadata"
+#define kofxHapMetadataVersion 1
+
+ofxHap::MovieMetadata::MovieMetadata()
+: _start(AV_NOPTS_VALUE), _duration(AV_NOPTS_VALUE), _bitRate(0)
+{
+
+}
+
+bool ofxHap::MovieMetadata::isValid() const
+{
+    return _streams.size() > 0;
+}
+
+void ofxHap::MovieMetadata::capture(const AVFormatContext *context)
+{
+    _start = context->start_time;
+    _duration = context->duration;
+    _bitRate = context->bit_rate;
+    _streams.clear();
+    for (unsigned int i = 0; i < context->nb_streams; i++)
+    {
+        const AVStream *stream = context->streams[i];
+#if OFX_HAP_HAS_CODECPAR
+        const AVCodecParameters *p = stream->codecpar;
+#else
+        const AVCodecContext *p = stream->codec;
+#endif
+        Stream s;
+        s.type = p->codec_type;
+        s.codecID = p->codec_id;
+        s.codecTag = p->codec_tag;
+        s.timeBaseNum = stream->time_base.num;
+        s.timeBaseDen = stream->time_base.den;
+        s.start = stream->start_time;
+        s.duration = stream->duration;
+        s.frames = stream->nb_frames;
+        s.frameRateNum = stream->avg_frame_rate.num;
+        s.frameRateDen = stream->avg_frame_rate.den;
+#if OFX_HAP_HAS_CODECPAR
+        s.format = p->format;
+#else
+        s.format = p->codec_type == AVMEDIA_TYPE_AUDIO ? p->sample_fmt : p->pix_fmt;
+#endif
+        s.bitRate = p->bit_rate;
+        s.width = p->width;
+        s.height = p->height;
+        s.sampleRate = p->sample_rate;
+#if OFX_HAP_HAS_CHANNEL_LAYOUT
+        s.channels = p->ch_layout.nb_channels;
+        s.channelLayout = p->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? p->ch_layout.u.mask : 0;
+#else
+        s.channels = p->channels;
+        s.channelLayout = p->channel_layout;
+#endif
+        s.frameSize = p->frame_size;
+        s.blockAlign = p->block_align;
+        s.bitsPerCodedSample = p->bits_per_coded_sample;
+        _streams.push_back(s);
+    }
+}
+
+bool ofxHap::MovieMetadata::apply(AVFormatContext *context) const
+{
+    if (!isValid() || context->nb_streams != _streams.size())
+    {
+        return false;
+    }
+    // Check everything matches before changing anything
+    for (unsigned int i = 0; i < context->nb_streams; i++)
+    {
+#if OFX_HAP_HAS_CODECPAR
+        const AVCodecParameters *p = context->streams[i]->codecpar;
+#else
+        const AVCodecContext *p = context->streams[i]->codec;
+#endif
+        if (p->codec_type != _streams[i].type || p->codec_id != _streams[i].codecID)
+        {
+            return false;
+        }
+    }
+    context->start_time = _start;
+    context->duration = _duration;
+    context->bit_rate = _bitRate;
+    for (unsigned int i = 0; i < context->nb_streams; i++)
+    {
+        const Stream& s = _streams[i];
+        AVStream *stream = context->streams[i];
+#if OFX_HAP_HAS_CODECPAR
+        AVCodecParameters *p = stream->codecpar;
+#else
+        AVCodecContext *p = stream->codec;
+#endif
+        p->codec_tag = s.codecTag;
+        stream->time_base = { s.timeBaseNum, s.timeBaseDen };
+        stream->start_time = s.start;
+        stream->duration = s.duration;
+        stream->nb_frames = s.frames;
+        stream->avg_frame_rate = { s.frameRateNum, s.frameRateDen };
+#if OFX_HAP_HAS_CODECPAR
+        p->format = s.format;
+#else
+        if (p->codec_type == AVMEDIA_TYPE_AUDIO)
+        {
+            p->sample_fmt = static_cast<AVSampleFormat>(s.format);
+        }
+        else
+        {
+            p->pix_fmt = static_cast<AVPixelFormat>(s.format);
+        }
+#endif
+        p->bit_rate = s.bitRate;
+        p->width = s.width;
+        p->height = s.height;
+        p->sample_rate = s.sampleRate;
+#if OFX_HAP_HAS_CHANNEL_LAYOUT
+        av_channel_layout_uninit(&p->ch_layout);
+        if (s.channelLayout != 0)
+        {
+            av_channel_layout_from_mask(&p->ch_layout, s.channelLayout);
+        }
+        else if (s.channels > 0)
+        {
+            av_channel_layout_default(&p->ch_layout, s.channels);
+        }
+#else
+        p->channels = s.channels;
+        p->channel_layout = s.channelLayout;
+#endif
+        p->frame_size = s.frameSize;
+        p->block_align = s.blockAlign;
+        p->bits_per_coded_sample = s.bitsPerCodedSample;
+    }
+    return true;
+}
+
+bool ofxHap::MovieMetadata::load(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string signature;
+    int version = 0;
+    size_t count = 0;
+    file >> signature >> version >> _start >> _duration >> _bitRate >> count;
+    if (!file || signature != kofxHapMetadataSignature || version != kofxHapMetadataVersion || count > 1024)
+    {
+        _streams.clear();
+        return false;
+    }
+    _streams.resize(count);
+    for (auto& s : _streams)
+    {
+        file >> s.type >> s.codecID >> s.codecTag
+             >> s.timeBaseNum >> s.timeBaseDen >> s.start >> s.duration >> s.frames
+             >> s.frameRateNum >> s.frameRateDen
+             >> s.format >> s.bitRate >> s.width >> s.height
+             >> s.sampleRate >> s.channels >> s.channelLayout
+             >> s.frameSize >> s.blockAlign >> s.bitsPerCodedSample;
+    }
+    if (!file || count == 0)
+    {
+        _streams.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ofxHap::MovieMetadata::save(const std::string& path) const
+{
+    // Write to a temporary file and move it into place so a reader never sees
+    // a partial file
+    // Another thread may be writing the same file, so include our thread in the temporary name
+    std::string temporary = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        file << kofxHapMetadataSignature << " " << kofxHapMetadataVersion << "\n"
+             << _start << " " << _duration << " " << _bitRate << " " << _streams.size() << "\n";
+        for (const auto& s : _streams)
+        {
+            file << s.type << " " << s.codecID << " " << s.codecTag << " "
+                 << s.timeBaseNum << " " << s.timeBaseDen << " " << s.start << " " << s.duration << " " << s.frames << " "
+                 << s.frameRateNum << " " << s.frameRateDen << " "
+                 << s.format << " " << s.bitRate << " " << s.width << " " << s.height << " "
+                 << s.sampleRate << " " << s.channels << " " << s.channelLayout << " "
+                 << s.frameSize << " " << s.blockAlign << " " << s.bitsPerCodedSample << "\n";
+        }
+        if (!file)
+        {
+            return false;
+        }
+    }
+#if defined(_WIN32)
+    // rename() won't replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
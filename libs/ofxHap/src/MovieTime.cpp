@@ -47,12 +47,12 @@ ofxHap::TimeRange ofxHap::MovieTime::nextRange(const ofxHap::Clock& clock, int64
     Clock::Direction direction = clock.getDirectionAt(absolute);
     if (direction == Clock::Direction::Backwards)
     {
-        int64_t duration = std::min(start + 1, limit);
+        int64_t duration = std::min(std::max(start - clock.getIn() + 1, INT64_C(0)), limit);
         return TimeRange(start, -duration);
     }
     else
     {
-        int64_t duration = std::min(clock.period - start, limit);
+        int64_t duration = std::min(std::max(clock.getOut() - start, INT64_C(0)), limit);
         return TimeRange(start, duration);
     }
 }
@@ -31,52 +31,306 @@ extern "C" {
 }
 #include <ofxHap/TimeRangeSet.h>
 #include <ofxHap/Common.h>
+#include <mutex>
+
+namespace ofxHap {
+    // Empty shells kept for reuse by all players
+    static const size_t kShellPoolMax = 1024;
+
+    static AVPacket *packetAlloc()
+    {
+#if OFX_HAP_HAS_PACKET_ALLOC
+        return av_packet_alloc();
+#else
+        AVPacket *packet = static_cast<AVPacket *>(av_malloc(sizeof(AVPacket)));
+        if (packet)
+        {
+            av_init_packet(packet);
+            packet->data = nullptr;
+            packet->size = 0;
+        }
+        return packet;
+#endif
+    }
+
+    static void packetDestroy(AVPacket *p)
+    {
+#if OFX_HAP_HAS_PACKET_ALLOC
+        av_packet_free(&p);
+#else
+        av_freep(&p);
+#endif
+    }
+
+    static void frameDestroy(AVFrame *f)
+    {
+        av_frame_free(&f);
+    }
+
+    /*
+     Packets and frames are freed back to a pool, so steady playback reuses
+     them rather than allocating. Only the shells are kept: their buffers
+     are released when they are returned.
+     */
+    template <class T, T *(*Alloc)(), void (*Destroy)(T *)>
+    class ShellPool {
+    public:
+        T *get()
+        {
+            {
+                std::lock_guard<std::mutex> guard(_lock);
+                if (_shells.size() > 0)
+                {
+                    T *shell = _shells.back();
+                    _shells.pop_back();
+                    return shell;
+                }
+            }
+            return Alloc();
+        }
+        // The shell must be unreferenced
+        void put(T *shell)
+        {
+            {
+                std::lock_guard<std::mutex> guard(_lock);
+                if (_shells.size() < kShellPoolMax)
+                {
+                    _shells.push_back(shell);
+                    return;
+                }
+            }
+            Destroy(shell);
+        }
+    private:
+        std::mutex      _lock;
+        std::vector<T *> _shells;
+    };
+
+    typedef ShellPool<AVPacket, packetAlloc, packetDestroy> PacketPool;
+    typedef ShellPool<AVFrame, av_frame_alloc, frameDestroy> FramePool;
+
+    // Never destroyed, so they outlive any player which might still be returning shells
+    static PacketPool& packetPool()
+    {
+        static PacketPool *pool = new PacketPool();
+        return *pool;
+    }
+
+    static FramePool& framePool()
+    {
+        static FramePool *pool = new FramePool();
+        return *pool;
+    }
+}
 
 ofxHap::TimeRange ofxHap::PacketQuery(AVPacket *p)
 {
     return TimeRange(p->pts, p->duration);
 }
 
+int64_t ofxHap::PacketSize(AVPacket *p)
+{
+    return p->size;
+}
+
+AVPacket *ofxHap::PacketAlloc()
+{
+    return packetPool().get();
+}
+
 AVPacket *ofxHap::PacketClone(AVPacket *p)
 {
-#if OFX_HAP_HAS_PACKET_ALLOC
-    AVPacket *packet = av_packet_clone(p);
-#else
-    AVPacket *packet = static_cast<AVPacket *>(av_malloc(sizeof(AVPacket)));
-    av_init_packet(packet);
-    packet->data = nullptr;
-    packet->size = 0;
-    av_packet_ref(packet, p);
-#endif
+    AVPacket *packet = packetPool().get();
+    if (packet && av_packet_ref(packet, p) < 0)
+    {
+        packetPool().put(packet);
+        packet = nullptr;
+    }
     return packet;
 }
 
 void ofxHap::PacketFree(AVPacket *p)
 {
-#if OFX_HAP_HAS_PACKET_ALLOC
-    av_packet_free(&p);
-#else
-    av_packet_unref(p);
-    av_freep(&p);
-#endif
+    if (p)
+    {
+        av_packet_unref(p);
+        packetPool().put(p);
+    }
+}
+
+ofxHap::LockingPacketCache::LockingPacketCache()
+: _inbox(nullptr), _spare(nullptr), _waiting(false)
+{
+
+}
+
+ofxHap::LockingPacketCache::~LockingPacketCache()
+{
+    // Anything still in the inbox is freed with the rest
+    receive();
+    Cache::clear();
+    Node *node = _spare.exchange(nullptr);
+    while (node)
+    {
+        Node *next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+void ofxHap::LockingPacketCache::push(std::atomic<Node *>& stack, Node *first, Node *last)
+{
+    last->next = stack.load();
+    while (!stack.compare_exchange_weak(last->next, first))
+    {
+    }
+}
+
+ofxHap::LockingPacketCache::Node *ofxHap::LockingPacketCache::last(Node *first)
+{
+    while (first->next)
+    {
+        first = first->next;
+    }
+    return first;
+}
+
+ofxHap::LockingPacketCache::Node *ofxHap::LockingPacketCache::getNodes(size_t count)
+{
+    // Only one thread pops spare nodes at a time, which avoids the ABA
+    // problem. Others allocate rather than wait.
+    Node *first = nullptr;
+    size_t taken = 0;
+    std::unique_lock<std::mutex> locker(_spareLock, std::try_to_lock);
+    if (locker.owns_lock())
+    {
+        Node *node = _spare.load();
+        while (taken < count && node)
+        {
+            if (_spare.compare_exchange_weak(node, node->next))
+            {
+                node->next = first;
+                first = node;
+                taken++;
+                node = _spare.load();
+            }
+        }
+    }
+    for (; taken < count; taken++)
+    {
+        Node *node = new Node();
+        node->next = first;
+        first = node;
+    }
+    return first;
+}
+
+void ofxHap::LockingPacketCache::push(Node *first, Node *last)
+{
+    // Nodes are pushed newest first, and reversed by receive()
+    push(_inbox, first, last);
+    // Only take the lock if a timed fetch might be waiting
+    if (_waiting.load())
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _condition.notify_one();
+    }
+}
+
+bool ofxHap::LockingPacketCache::receive()
+{
+    Node *node = _inbox.exchange(nullptr);
+    if (node == nullptr)
+    {
+        return false;
+    }
+    Node *ordered = nullptr;
+    while (node)
+    {
+        Node *next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+    Node *last = ordered;
+    for (Node *itr = ordered; itr; itr = itr->next)
+    {
+        if (itr->cache)
+        {
+            Cache::cache();
+        }
+        else
+        {
+            adopt(itr->packet);
+        }
+        itr->packet = nullptr;
+        last = itr;
+    }
+    // Keep the nodes for reuse
+    push(_spare, ordered, last);
+    return true;
 }
 
 void ofxHap::LockingPacketCache::store(AVPacket *p)
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    Cache::store(p);
-    _condition.notify_one();
+    // Clone first, so a failed clone queues nothing
+    AVPacket *packet = PacketClone(p);
+    if (packet)
+    {
+        Node *node = getNodes(1);
+        node->packet = packet;
+        node->cache = false;
+        push(node, node);
+    }
+}
+
+void ofxHap::LockingPacketCache::store(const std::vector<AVPacket *>& packets)
+{
+    if (packets.size() == 0)
+    {
+        return;
+    }
+    // Fill the batch newest first, and push it all at once. Nodes left
+    // over by failed clones go back to the spares.
+    Node *first = getNodes(packets.size());
+    Node *unused = first;
+    Node *filled = nullptr;
+    for (auto packet = packets.rbegin(); packet != packets.rend(); ++packet)
+    {
+        AVPacket *clone = PacketClone(*packet);
+        if (clone)
+        {
+            unused->packet = clone;
+            unused->cache = false;
+            filled = unused;
+            unused = unused->next;
+        }
+    }
+    if (unused)
+    {
+        if (filled)
+        {
+            filled->next = nullptr;
+        }
+        push(_spare, unused, last(unused));
+    }
+    if (filled)
+    {
+        push(first, filled);
+    }
 }
 
 void ofxHap::LockingPacketCache::cache()
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    Cache::cache();
+    Node *node = getNodes(1);
+    node->packet = nullptr;
+    node->cache = true;
+    push(node, node);
 }
 
-bool ofxHap::LockingPacketCache::fetch(int64_t pts, AVPacket *p) const
+bool ofxHap::LockingPacketCache::fetch(int64_t pts, AVPacket *p)
 {
-    std::lock_guard<std::mutex> guard(_lock);
+    receive();
     AVPacket *found = Cache::fetch(pts);
     if (found)
     {
@@ -85,50 +339,96 @@ bool ofxHap::LockingPacketCache::fetch(int64_t pts, AVPacket *p) const
     return found == nullptr ? false : true;
 }
 
-bool ofxHap::LockingPacketCache::fetch(int64_t pts, AVPacket *p, std::chrono::microseconds timeout) const
+bool ofxHap::LockingPacketCache::fetch(int64_t pts, AVPacket *p, std::chrono::microseconds timeout)
 {
+    if (fetch(pts, p))
+    {
+        return true;
+    }
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now() + timeout;
     std::unique_lock<std::mutex> locker(_lock);
-    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
-    std::chrono::time_point<std::chrono::steady_clock> end = now + timeout;
-    AVPacket *found;
+    // Set before checking the inbox so a push after the check will notify us
+    _waiting.store(true);
+    AVPacket *found = nullptr;
     do {
-        found = Cache::fetch(pts);
-        if (found)
+        if (receive())
         {
-            av_packet_ref(p, found);
+            found = Cache::fetch(pts);
         }
-        else
+        if (!found)
         {
-            _condition.wait_for(locker, end - now);
-            now = std::chrono::steady_clock::now();
+            _condition.wait_until(locker, end, [this]() {
+                return _inbox.load() != nullptr;
+            });
         }
-    } while (found == nullptr && now < end);
+    } while (found == nullptr && std::chrono::steady_clock::now() < end);
+    _waiting.store(false);
+    if (!found)
+    {
+        // Something may have arrived as we timed out
+        receive();
+        found = Cache::fetch(pts);
+    }
+    if (found)
+    {
+        av_packet_ref(p, found);
+    }
     return found == nullptr ? false : true;
 }
 
 void ofxHap::LockingPacketCache::limit(const TimeRangeSet& ranges)
 {
-    std::lock_guard<std::mutex> guard(_lock);
+    receive();
     Cache::limit(ranges);
 }
 
 void ofxHap::LockingPacketCache::clear()
 {
-    std::lock_guard<std::mutex> guard(_lock);
+    receive();
     Cache::clear();
 }
 
+AVFrame *ofxHap::FrameAlloc()
+{
+    return framePool().get();
+}
+
 AVFrame *ofxHap::FrameClone(AVFrame *f)
 {
-    return av_frame_clone(f);
+    AVFrame *frame = framePool().get();
+    if (frame && av_frame_ref(frame, f) < 0)
+    {
+        framePool().put(frame);
+        frame = nullptr;
+    }
+    return frame;
 }
 
 void ofxHap::FrameFree(AVFrame *f)
 {
-    av_frame_free(&f);
+    if (f)
+    {
+        av_frame_unref(f);
+        framePool().put(f);
+    }
 }
 
 ofxHap::TimeRange ofxHap::FrameQuery(AVFrame *f)
 {
     return TimeRange(f->best_effort_timestamp, f->nb_samples);
 }
+
+int64_t ofxHap::FrameSize(AVFrame *f)
+{
+    // Count the buffers the frame holds, which may be larger than its samples
+    int64_t size = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && f->buf[i]; i++)
+    {
+        size += f->buf[i]->size;
+    }
+    for (int i = 0; i < f->nb_extended_buf; i++)
+    {
+        size += f->extended_buf[i]->size;
+    }
+    return size;
+}
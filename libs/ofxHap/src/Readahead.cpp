@@ -0,0 +1,77 @@
+/*
+ Readahead.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/Readahead.h>
+#include <algorithm>
+#include <climits>
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define OFX_HAP_HAS_READ_ADVICE 1
+#else
+#define OFX_HAP_HAS_READ_ADVICE 0
+#endif
+
+ofxHap::Readahead::Readahead(const std::string& movie)
+: _file(-1)
+{
+#if OFX_HAP_HAS_READ_ADVICE
+    // Only local files can be advised
+    if (movie.find("://") == std::string::npos)
+    {
+        _file = open(movie.c_str(), O_RDONLY);
+    }
+#endif
+}
+
+ofxHap::Readahead::~Readahead()
+{
+#if OFX_HAP_HAS_READ_ADVICE
+    if (_file != -1)
+    {
+        close(_file);
+    }
+#endif
+}
+
+void ofxHap::Readahead::advise(int64_t offset, int64_t length)
+{
+#if OFX_HAP_HAS_READ_ADVICE
+    if (_file != -1 && offset >= 0 && length > 0)
+    {
+#if defined(__APPLE__)
+        struct radvisory advice;
+        advice.ra_offset = offset;
+        advice.ra_count = static_cast<int>(std::min(length, static_cast<int64_t>(INT_MAX)));
+        fcntl(_file, F_RDADVISE, &advice);
+#else
+        // WILLNEED starts asynchronous reads into the page cache, unlike readahead() which can block
+        posix_fadvise(_file, offset, length, POSIX_FADV_WILLNEED);
+#endif
+    }
+#endif
+}
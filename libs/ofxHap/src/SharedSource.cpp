@@ -0,0 +1,379 @@
+/*
+ SharedSource.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <ofxHap/SharedSource.h>
+#include <ofxHap/Common.h>
+extern "C" {
+#include <libavformat/avformat.h>
+}
+#include <algorithm>
+#include <map>
+#include <cassert>
+
+namespace ofxHap {
+    // Enough for players a few frames apart to find each other's frames
+    static const size_t kSharedFrameCount = 4;
+}
+
+std::shared_ptr<ofxHap::SharedSource> ofxHap::SharedSource::get(const std::string& movie, const FileIdentity& identity, const std::string& metadata)
+{
+    static std::mutex lock;
+    static std::map<std::string, std::weak_ptr<SharedSource>> existing;
+    std::lock_guard<std::mutex> guard(lock);
+    std::string key = identity.getKey();
+    std::shared_ptr<SharedSource> source = existing[key].lock();
+    if (!source)
+    {
+        source = std::make_shared<SharedSource>(movie, metadata);
+        existing[key] = source;
+    }
+    // Forget any sources which have gone
+    for (auto itr = existing.begin(); itr != existing.end();)
+    {
+        if (itr->second.expired())
+            itr = existing.erase(itr);
+        else
+            ++itr;
+    }
+    return source;
+}
+
+ofxHap::SharedSource::SharedSource(const std::string& movie, const std::string& metadata)
+: _duration(-1), _foundAll(false), _error(0), _videoStreamIndex(-1),
+  _packets(std::make_shared<LockingPacketCache>()),
+  _demuxer(std::make_shared<Demuxer>(movie, *this, 0, metadata, Demuxer::Streams::Video))
+{
+
+}
+
+ofxHap::SharedSource::~SharedSource()
+{
+    // Stop the demuxer before our other members go
+    _demuxer.reset();
+}
+
+void ofxHap::SharedSource::subscribe(PacketReceiver& receiver)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _receivers.push_back(&receiver);
+    {
+        std::lock_guard<std::mutex> subscribers(_subscriberLock);
+        _subscribers.emplace_back(&receiver);
+    }
+    // Catch up with anything already found
+    if (_duration >= 0)
+    {
+        receiver.foundMovie(_duration);
+    }
+    for (auto stream : _streams)
+    {
+        receiver.foundStream(stream);
+    }
+    if (_foundAll)
+    {
+        receiver.foundAllStreams();
+    }
+    if (_error)
+    {
+        receiver.error(_error);
+    }
+}
+
+void ofxHap::SharedSource::unsubscribe(PacketReceiver& receiver)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _receivers.erase(std::remove(_receivers.begin(), _receivers.end(), &receiver), _receivers.end());
+    std::lock_guard<std::mutex> subscribers(_subscriberLock);
+    _subscribers.erase(std::remove_if(_subscribers.begin(), _subscribers.end(), [&receiver](const Subscriber& s) {
+        return s.receiver == &receiver;
+    }), _subscribers.end());
+    if (_subscribers.empty())
+    {
+        _consumer = std::thread::id();
+    }
+    updateActive();
+}
+
+size_t ofxHap::SharedSource::getSubscriberCount() const
+{
+    std::lock_guard<std::mutex> guard(_subscriberLock);
+    return _subscribers.size();
+}
+
+std::shared_ptr<ofxHap::Demuxer> ofxHap::SharedSource::getDemuxer() const
+{
+    return _demuxer;
+}
+
+std::shared_ptr<ofxHap::LockingPacketCache> ofxHap::SharedSource::getPackets() const
+{
+    return _packets;
+}
+
+ofxHap::TimeRangeSet ofxHap::SharedSource::getActive() const
+{
+    std::lock_guard<std::mutex> guard(_subscriberLock);
+    checkConsumer();
+    return _active;
+}
+
+void ofxHap::SharedSource::setActive(PacketReceiver& receiver, const TimeRangeSet& active)
+{
+    std::lock_guard<std::mutex> guard(_subscriberLock);
+    checkConsumer();
+    for (auto& subscriber : _subscribers)
+    {
+        if (subscriber.receiver == &receiver)
+        {
+            subscriber.active = active;
+        }
+    }
+    updateActive();
+}
+
+bool ofxHap::SharedSource::cancel(PacketReceiver& receiver)
+{
+    bool waiting = false;
+    {
+        std::lock_guard<std::mutex> guard(_subscriberLock);
+        checkConsumer();
+        for (auto& subscriber : _subscribers)
+        {
+            if (subscriber.receiver == &receiver)
+            {
+                subscriber.active.clear();
+            }
+            else if (subscriber.active.size() > 0)
+            {
+                waiting = true;
+            }
+        }
+        updateActive();
+    }
+    // The demuxer's queue may hold another subscriber's reads, so only they can keep it
+    if (!waiting)
+    {
+        _demuxer->cancel();
+    }
+    return !waiting;
+}
+
+void ofxHap::SharedSource::checkConsumer() const
+{
+    // The packet cache has one consumer, so every subscriber must be updated from the
+    // thread the first was
+    if (_consumer == std::thread::id())
+    {
+        _consumer = std::this_thread::get_id();
+    }
+    assert(_consumer == std::this_thread::get_id());
+}
+
+void ofxHap::SharedSource::updateActive()
+{
+    _active.clear();
+    for (const auto& subscriber : _subscribers)
+    {
+        for (const auto& range : subscriber.active)
+        {
+            _active.add(range);
+        }
+    }
+}
+
+const ofxHap::TimeRangeSet& ofxHap::SharedSource::limit(PacketReceiver& receiver, const TimeRangeSet& keep, const TimeRangeSet& packets)
+{
+    std::lock_guard<std::mutex> guard(_subscriberLock);
+    checkConsumer();
+    _kept.clear();
+    _keptPackets.clear();
+    for (auto& subscriber : _subscribers)
+    {
+        if (subscriber.receiver == &receiver)
+        {
+            subscriber.keep = keep;
+            subscriber.packets = packets;
+        }
+        for (const auto& range : subscriber.keep)
+        {
+            _kept.add(range);
+        }
+        for (const auto& range : subscriber.packets)
+        {
+            _keptPackets.add(range);
+        }
+    }
+    _packets->limit(_keptPackets);
+    return _kept;
+}
+
+ofxHap::SharedSource::Frame::Frame()
+: pts(0), duration(0)
+{
+
+}
+
+bool ofxHap::SharedSource::fetchFrame(int64_t position, Frame& frame) const
+{
+    std::lock_guard<std::mutex> guard(_frameLock);
+    for (const auto& stored : _frames)
+    {
+        if (stored.pts <= position && stored.pts + stored.duration > position)
+        {
+            frame.pts = stored.pts;
+            frame.duration = stored.duration;
+            frame.data = stored.data;
+            return true;
+        }
+    }
+    return false;
+}
+
+ofxHap::SharedSource::Frame ofxHap::SharedSource::storeFrame(int64_t pts, int64_t duration, std::vector<char>& buffer)
+{
+    std::lock_guard<std::mutex> guard(_frameLock);
+    std::shared_ptr<std::vector<char>> data = std::move(_spare);
+    if (!data)
+    {
+        data = std::make_shared<std::vector<char>>();
+    }
+    // The caller decodes its next frame into the spare's storage
+    data->swap(buffer);
+    _frames.erase(std::remove_if(_frames.begin(), _frames.end(), [pts](const StoredFrame& f) {
+        return f.pts == pts;
+    }), _frames.end());
+    _frames.push_back(StoredFrame{ pts, duration, data });
+    if (_frames.size() > kSharedFrameCount)
+    {
+        // Reuse the oldest frame's storage if no player is still showing it
+        if (_frames.front().data.use_count() == 1)
+        {
+            _spare = std::move(_frames.front().data);
+        }
+        _frames.erase(_frames.begin());
+    }
+    Frame frame;
+    frame.pts = pts;
+    frame.duration = duration;
+    frame.data = data;
+    return frame;
+}
+
+int64_t ofxHap::SharedSource::getFrameBytes() const
+{
+    std::lock_guard<std::mutex> guard(_frameLock);
+    size_t bytes = _spare ? _spare->capacity() : 0;
+    for (const auto& frame : _frames)
+    {
+        bytes += frame.data->capacity();
+    }
+    return bytes;
+}
+
+void ofxHap::SharedSource::foundMovie(int64_t duration)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _duration = duration;
+    for (auto receiver : _receivers)
+    {
+        receiver->foundMovie(duration);
+    }
+}
+
+void ofxHap::SharedSource::foundStream(AVStream *stream)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+#if OFX_HAP_HAS_CODECPAR
+    AVMediaType type = stream->codecpar->codec_type;
+    AVCodecID codecID = stream->codecpar->codec_id;
+#else
+    AVMediaType type = stream->codec->codec_type;
+    AVCodecID codecID = stream->codec->codec_id;
+#endif
+    if (type == AVMEDIA_TYPE_VIDEO && codecID == AV_CODEC_ID_HAP && _videoStreamIndex < 0)
+    {
+        _videoStreamIndex = stream->index;
+    }
+    _streams.push_back(stream);
+    for (auto receiver : _receivers)
+    {
+        receiver->foundStream(stream);
+    }
+}
+
+void ofxHap::SharedSource::foundAllStreams()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _foundAll = true;
+    for (auto receiver : _receivers)
+    {
+        receiver->foundAllStreams();
+    }
+}
+
+void ofxHap::SharedSource::readPacket(AVPacket *packet)
+{
+    if (packet->stream_index == _videoStreamIndex)
+    {
+        _packets->store(packet);
+    }
+}
+
+void ofxHap::SharedSource::readPackets(const std::vector<AVPacket *>& packets)
+{
+    std::vector<AVPacket *> video;
+    for (auto packet : packets)
+    {
+        if (packet->stream_index == _videoStreamIndex)
+        {
+            video.push_back(packet);
+        }
+    }
+    if (video.size() > 0)
+    {
+        _packets->store(video);
+    }
+}
+
+void ofxHap::SharedSource::discontinuity()
+{
+    _packets->cache();
+}
+
+void ofxHap::SharedSource::endMovie()
+{
+    // Subscribers read audio themselves, so have nothing to end
+}
+
+void ofxHap::SharedSource::error(int averror)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _error = averror;
+    for (auto receiver : _receivers)
+    {
+        receiver->error(averror);
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ StorageDevice.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/StorageDevice.h>
+#include <fstream>
+#if defined(__linux__)
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#elif defined(__APPLE__)
+#include <sys/param.h>
+#include <sys/mount.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace ofxHap {
+#if defined(__linux__)
+    static bool isNetworkFileSystem(long type)
+    {
+        switch (type) {
+            case 0x6969:        // NFS
+            case 0x517B:        // SMB
+            case 0xFF534D42:    // CIFS
+            case 0xFE534D42:    // SMB2
+            case 0x65735546:    // FUSE, commonly a network mount
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static StorageDevice::Kind blockDeviceKind(dev_t device)
+    {
+        std::string base = "/sys/dev/block/" + std::to_string(major(device)) + ":" + std::to_string(minor(device));
+        // A partition's queue belongs to its parent device
+        for (const char *queue : { "/queue/rotational", "/../queue/rotational" })
+        {
+            std::ifstream file(base + queue);
+            int rotational;
+            if (file >> rotational)
+            {
+                return rotational ? StorageDevice::Kind::Rotational : StorageDevice::Kind::SolidState;
+            }
+        }
+        return StorageDevice::Kind::Unknown;
+    }
+#endif
+}
+
+ofxHap::StorageDevice::StorageDevice(const std::string& movie)
+: _kind(Kind::Unknown)
+{
+    if (movie.find("://") != std::string::npos)
+    {
+        _kind = Kind::Network;
+        return;
+    }
+#if defined(__linux__)
+    struct statfs fs;
+    struct stat info;
+    if (statfs(movie.c_str(), &fs) == 0 && isNetworkFileSystem(fs.f_type))
+    {
+        _kind = Kind::Network;
+    }
+    else if (stat(movie.c_str(), &info) == 0)
+    {
+        _kind = blockDeviceKind(info.st_dev);
+    }
+#elif defined(__APPLE__)
+    struct statfs fs;
+    if (statfs(movie.c_str(), &fs) == 0 && !(fs.f_flags & MNT_LOCAL))
+    {
+        _kind = Kind::Network;
+    }
+#elif defined(_WIN32)
+    if (movie.compare(0, 2, "\\\\") == 0)
+    {
+        _kind = Kind::Network;
+    }
+    else if (movie.length() > 2 && movie[1] == ':')
+    {
+        std::string root = movie.substr(0, 2) + "\\";
+        if (GetDriveTypeA(root.c_str()) == DRIVE_REMOTE)
+        {
+            _kind = Kind::Network;
+        }
+    }
+#endif
+}
+
+ofxHap::StorageDevice::Kind ofxHap::StorageDevice::getKind() const
+{
+    return _kind;
+}
+
+int ofxHap::StorageDevice::getConcurrentReads() const
+{
+    switch (_kind) {
+        case Kind::Rotational:
+            // Concurrent reads make a disk seek between them
+            return 1;
+        case Kind::SolidState:
+        case Kind::Network:
+            return 4;
+        default:
+            return 2;
+    }
+}
@@ -28,6 +28,10 @@
 #include <ofxHap/TimeRangeSet.h>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 ofxHap::TimeRangeSet::TimeRangeSet()
 {
@@ -74,31 +78,27 @@ void ofxHap::TimeRangeSet::add(const ofxHap::TimeRange &r)
     {
         for (auto itr = _ranges.begin(); itr != _ranges.end(); ++itr)
         {
-            if (itr->intersects(range))
+            if (itr->intersects(range) || itr->latest() == range.start - 1 || itr->start == range.latest() + 1)
             {
+                // Extend this range, absorbing any which follow it that it now reaches
                 int64_t end = std::max(itr->latest(), range.latest());
                 itr->start = std::min(itr->start, range.start);
+                auto next = itr + 1;
+                while (next != _ranges.end() && next->start <= end + 1)
+                {
+                    end = std::max(end, next->latest());
+                    next = _ranges.erase(next);
+                }
                 itr->length = end - itr->start + 1;
                 return;
             }
-            else if (itr->latest() == range.start - 1)
-            {
-                itr->length += range.length;
-                return;
-            }
-            else if (itr->start == range.latest() + 1)
-            {
-                itr->start = range.start;
-                itr->length += range.length;
-                return;
-            }
             else if (itr->latest() > range.start)
             {
                 _ranges.insert(itr, range);
                 return;
             }
         }
-        _ranges.emplace_back(range);
+        _ranges.push_back(range);
     }
 }
 
@@ -107,8 +107,9 @@ void ofxHap::TimeRangeSet::remove(int64_t start, int64_t length)
     remove(TimeRange(start, length));
 }
 
-void ofxHap::TimeRangeSet::remove(const ofxHap::TimeRange &range)
+void ofxHap::TimeRangeSet::remove(const ofxHap::TimeRange &r)
 {
+    TimeRange range = r.abs();
     if (range.length)
     {
         for (auto itr = _ranges.begin(); itr != _ranges.end();) {
@@ -118,7 +119,8 @@ void ofxHap::TimeRangeSet::remove(const ofxHap::TimeRange &range)
                 {
                     TimeRange remainder(range.latest() + 1, itr->latest() - range.latest());
                     itr->length -= remainder.length;
-                    _ranges.insert(itr, remainder);
+                    // The remainder follows this range, keeping the set in order
+                    itr = _ranges.insert(itr + 1, remainder) - 1;
                 }
                 if (itr->start < range.start)
                 {
@@ -308,7 +310,11 @@ void ofxHap::TimeRangeSequence::remove(const ofxHap::TimeRange &range)
                                 remainder.start = remainder.latest();
                                 remainder.length = -remainder.length;
                             }
-                            _ranges.insert(itr, remainder);
+                            // Keep the remainder after this range in the order it will be played
+                            if (itr->length < 0)
+                                itr = _ranges.insert(itr, remainder) + 1;
+                            else
+                                itr = _ranges.insert(itr + 1, remainder) - 1;
                         }
                         // Shorten
                         itr->setLatest(range.earliest() - 1);
@@ -331,3 +337,114 @@ void ofxHap::TimeRangeSequence::remove(const ofxHap::TimeRangeSet &set)
         remove(range);
     }
 }
+
+static_assert(std::is_trivially_copyable<ofxHap::TimeRange>::value, "TimeRangeStorage copies ranges bytewise");
+
+ofxHap::TimeRangeStorage::TimeRangeStorage()
+: _data(reinterpret_cast<TimeRange *>(_inline)), _size(0), _capacity(kInlineCount)
+{
+
+}
+
+ofxHap::TimeRangeStorage::TimeRangeStorage(const TimeRangeStorage& o)
+: TimeRangeStorage()
+{
+    *this = o;
+}
+
+ofxHap::TimeRangeStorage::TimeRangeStorage(TimeRangeStorage&& o)
+: TimeRangeStorage()
+{
+    *this = std::move(o);
+}
+
+ofxHap::TimeRangeStorage::~TimeRangeStorage()
+{
+    release();
+}
+
+ofxHap::TimeRangeStorage& ofxHap::TimeRangeStorage::operator=(const TimeRangeStorage& o)
+{
+    if (this != &o)
+    {
+        reserve(o._size);
+        if (o._size)
+            std::memcpy(_data, o._data, o._size * sizeof(TimeRange));
+        _size = o._size;
+    }
+    return *this;
+}
+
+ofxHap::TimeRangeStorage& ofxHap::TimeRangeStorage::operator=(TimeRangeStorage&& o)
+{
+    if (this != &o)
+    {
+        if (o._data == reinterpret_cast<TimeRange *>(o._inline))
+        {
+            // Inline ranges have to be copied, but keep any capacity we already have
+            *this = static_cast<const TimeRangeStorage&>(o);
+        }
+        else
+        {
+            release();
+            _data = o._data;
+            _capacity = o._capacity;
+            _size = o._size;
+            o._data = reinterpret_cast<TimeRange *>(o._inline);
+            o._capacity = kInlineCount;
+        }
+        o._size = 0;
+    }
+    return *this;
+}
+
+ofxHap::TimeRangeStorage::iterator ofxHap::TimeRangeStorage::insert(iterator pos, const TimeRange& range)
+{
+    size_t index = pos - _data;
+    reserve(_size + 1);
+    pos = _data + index;
+    std::memmove(pos + 1, pos, (_size - index) * sizeof(TimeRange));
+    *pos = range;
+    _size++;
+    return pos;
+}
+
+ofxHap::TimeRangeStorage::iterator ofxHap::TimeRangeStorage::erase(iterator pos)
+{
+    std::memmove(pos, pos + 1, (end() - pos - 1) * sizeof(TimeRange));
+    _size--;
+    return pos;
+}
+
+void ofxHap::TimeRangeStorage::push_back(const TimeRange& range)
+{
+    reserve(_size + 1);
+    _data[_size] = range;
+    _size++;
+}
+
+void ofxHap::TimeRangeStorage::reserve(size_t count)
+{
+    if (count > _capacity)
+    {
+        size_t capacity = std::max(count, _capacity * 2);
+        TimeRange *data = static_cast<TimeRange *>(std::malloc(capacity * sizeof(TimeRange)));
+        if (!data)
+            throw std::bad_alloc();
+        if (_size)
+            std::memcpy(data, _data, _size * sizeof(TimeRange));
+        release();
+        _data = data;
+        _capacity = capacity;
+    }
+}
+
+void ofxHap::TimeRangeStorage::release()
+{
+    if (_data != reinterpret_cast<TimeRange *>(_inline))
+    {
+        std::free(_data);
+        _data = reinterpret_cast<TimeRange *>(_inline);
+        _capacity = kInlineCount;
+    }
+}
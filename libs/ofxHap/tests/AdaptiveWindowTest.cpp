@@ -0,0 +1,106 @@
+/*
+ AdaptiveWindowTest.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/AdaptiveWindow.h>
+#include "Check.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+    void testLimits()
+    {
+        ofxHap::AdaptiveWindow window(1000000, 4000000);
+        CHECK(window.getWindow() == 1000000);
+        for (int i = 0; i < 10; i++)
+        {
+            window.update(0.0, true);
+        }
+        CHECK(window.getWindow() == 4000000);
+        for (int i = 0; i < 100; i++)
+        {
+            window.update(0.0, false);
+        }
+        CHECK(window.getWindow() == 1000000);
+        window.setLimits(2000000, 1000000);
+        CHECK(window.getMinimum() == 2000000);
+        CHECK(window.getMaximum() == 2000000);
+        CHECK(window.getWindow() == 2000000);
+    }
+
+    void testLoad()
+    {
+        ofxHap::AdaptiveWindow window(0, 10000000);
+        window.setLimits(1000000, 10000000);
+        // Between the thresholds nothing changes
+        window.update(0.3, false);
+        CHECK(window.getWindow() == 1000000);
+        window.update(0.6, false);
+        CHECK(window.getWindow() == 1250000);
+        window.update(0.1, false);
+        CHECK(window.getWindow() == 1125000);
+        window.update(0.0, true);
+        CHECK(window.getWindow() == 2250000);
+    }
+
+    void testFromZero()
+    {
+        // A window which has shrunk to nothing must be able to grow again
+        ofxHap::AdaptiveWindow window(0, 4000000);
+        CHECK(window.getWindow() == 0);
+        window.update(0.0, true);
+        CHECK(window.getWindow() > 0);
+        int64_t last = window.getWindow();
+        window.update(1.0, false);
+        CHECK(window.getWindow() > last);
+        for (int i = 0; i < 1000; i++)
+        {
+            window.update(0.0, false);
+        }
+        CHECK(window.getWindow() == 0);
+        window.update(1.0, false);
+        CHECK(window.getWindow() > 0);
+        // Small windows grow as well as large ones
+        window.setLimits(0, 4000000);
+        for (int i = 0; i < 1000; i++)
+        {
+            window.update(0.0, false);
+        }
+        for (int i = 0; i < 10; i++)
+        {
+            window.update(0.0, true);
+        }
+        CHECK(window.getWindow() == 4000000);
+    }
+}
+
+int main()
+{
+    testLimits();
+    testLoad();
+    testFromZero();
+    return ofxHapTests::finish();
+}
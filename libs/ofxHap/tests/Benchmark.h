@@ -0,0 +1,90 @@
+/*
+ Benchmark.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef Benchmark_h
+#define Benchmark_h
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+// Measurements shared by the benchmarks
+
+namespace ofxHapBenchmarks {
+    // Context switches made by the process so far
+    struct Switches {
+        long voluntary;
+        long involuntary;
+    };
+
+    inline Switches switches()
+    {
+        Switches result = { 0, 0 };
+#if !defined(_WIN32)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            result.voluntary = usage.ru_nvcsw;
+            result.involuntary = usage.ru_nivcsw;
+        }
+#endif
+        return result;
+    }
+
+    // Delays in microseconds, added from any thread
+    class Latencies {
+    public:
+        void add(double microseconds)
+        {
+            // Early counts as on time
+            std::lock_guard<std::mutex> guard(_lock);
+            _samples.push_back(std::max(0.0, microseconds));
+        }
+        // Once every sample has been added
+        void summarise(double& mean, double& p99, double& max)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            std::sort(_samples.begin(), _samples.end());
+            mean = 0;
+            for (double s : _samples)
+            {
+                mean += s;
+            }
+            mean = _samples.size() ? mean / _samples.size() : 0;
+            p99 = _samples.size() ? _samples[_samples.size() * 99 / 100] : 0;
+            max = _samples.size() ? _samples.back() : 0;
+        }
+    private:
+        std::mutex          _lock;
+        std::vector<double> _samples;
+    };
+}
+
+#endif /* Benchmark_h */
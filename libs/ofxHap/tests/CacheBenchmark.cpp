@@ -0,0 +1,169 @@
+/*
+ CacheBenchmark.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/PacketCache.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ Times the packet cache's operations holding 2, 10 and 60 seconds of 120fps
+ content, using plain heap items in place of packets so no FFmpeg is needed.
+ */
+
+namespace {
+    const int64_t kTimeBase = 120000;
+    const int64_t kFrameDuration = 1000; // 120fps
+    const int64_t kFrameSize = 512 * 1024;
+
+    struct Item {
+        int64_t pts;
+        int64_t duration;
+    };
+
+    Item *itemClone(Item *i)
+    {
+        return new Item(*i);
+    }
+
+    void itemFree(Item *i)
+    {
+        delete i;
+    }
+
+    ofxHap::TimeRange itemQuery(Item *i)
+    {
+        return ofxHap::TimeRange(i->pts, i->duration);
+    }
+
+    int64_t itemSize(Item *)
+    {
+        return kFrameSize;
+    }
+
+    typedef ofxHap::Cache<Item *, itemClone, itemFree, itemQuery, itemSize> ItemCache;
+
+    typedef std::chrono::steady_clock Clock;
+
+    double nanoseconds(Clock::time_point start, int64_t count)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+    }
+
+    void fill(ItemCache& cache, int64_t frames)
+    {
+        // Stored as a demuxer would: in runs, each moved to the cache as playback seeks
+        Item item;
+        item.duration = kFrameDuration;
+        for (int64_t i = 0; i < frames; i++)
+        {
+            item.pts = i * kFrameDuration;
+            cache.store(&item);
+            if (i % 240 == 239)
+            {
+                cache.cache();
+            }
+        }
+        cache.cache();
+    }
+
+    void run(int seconds, int repeats)
+    {
+        const int64_t frames = seconds * kTimeBase / kFrameDuration;
+        double store = 0, fetch = 0, miss = 0, cache = 0, limit = 0;
+        for (int r = 0; r < repeats; r++)
+        {
+            ItemCache c;
+            Clock::time_point start = Clock::now();
+            fill(c, frames);
+            store += nanoseconds(start, frames);
+
+            // Fetch in a scattered order, as scrubbing would
+            int64_t found = 0;
+            start = Clock::now();
+            for (int64_t i = 0; i < frames; i++)
+            {
+                int64_t frame = (i * 7919) % frames;
+                if (c.fetch(frame * kFrameDuration + kFrameDuration / 2))
+                {
+                    found++;
+                }
+            }
+            fetch += nanoseconds(start, frames);
+            if (found != frames)
+            {
+                std::fprintf(stderr, "fetched %lld of %lld frames\n", (long long)found, (long long)frames);
+                std::exit(EXIT_FAILURE);
+            }
+
+            start = Clock::now();
+            for (int64_t i = 0; i < frames; i++)
+            {
+                if (c.fetch(-kFrameDuration * (i + 1)))
+                {
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            miss += nanoseconds(start, frames);
+
+            // One second of active packets merged into the full cache
+            Item item;
+            item.duration = kFrameDuration;
+            for (int64_t i = 0; i < 120; i++)
+            {
+                item.pts = (frames + i) * kFrameDuration;
+                c.store(&item);
+            }
+            start = Clock::now();
+            c.cache();
+            cache += nanoseconds(start, 1);
+
+            // Keep the middle half, as a cache window would
+            ofxHap::TimeRangeSet keep;
+            keep.add(frames / 4 * kFrameDuration, frames / 2 * kFrameDuration);
+            start = Clock::now();
+            c.limit(keep);
+            limit += nanoseconds(start, 1);
+        }
+        std::printf("%3ds %6lld frames: store %7.1fns fetch %6.1fns miss %6.1fns cache() %9.0fns limit() %9.0fns\n",
+                    seconds, (long long)frames,
+                    store / repeats, fetch / repeats, miss / repeats, cache / repeats, limit / repeats);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int repeats = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (repeats < 1)
+    {
+        repeats = 1;
+    }
+    run(2, repeats);
+    run(10, repeats);
+    run(60, repeats);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+/*
+ Check.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef Check_h
+#define Check_h
+
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ Checks for the tests. A failed check is reported and counted, and the test
+ carries on, so one run shows every failure. main() runs each test and
+ returns finish().
+ */
+
+namespace ofxHapTests {
+    inline int& failures()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    // Count a failure which has already been reported
+    inline void fail()
+    {
+        failures()++;
+    }
+
+    inline void fail(const char *file, int line, const char *condition)
+    {
+        std::fprintf(stderr, "%s:%d: failed: %s\n", file, line, condition);
+        fail();
+    }
+
+    inline int finish()
+    {
+        if (failures())
+        {
+            std::fprintf(stderr, "%d checks failed\n", failures());
+            return EXIT_FAILURE;
+        }
+        std::printf("all checks passed\n");
+        return EXIT_SUCCESS;
+    }
+}
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        ofxHapTests::fail(__FILE__, __LINE__, #condition); \
+    } \
+} while (0)
+
+#endif /* Check_h */
@@ -0,0 +1,234 @@
+/*
+ DemuxPoolBenchmark.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/DemuxPool.h>
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ Measures what it costs to wake players' audio work on time, comparing a
+ thread per player with timers on a shared pool. Each player does a little
+ work every period, as audio does when it refills its buffer. Reports the
+ threads used, context switches per second and how late each wake was.
+
+ Then measures how long a read waits when it is scheduled behind movies
+ being opened, with the opens on the read pool and on their own pool.
+
+ DemuxerBenchmark measures context switches and wake latency for Demuxers
+ reading a real movie.
+ */
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const std::chrono::microseconds kPeriod(20000);
+    const std::chrono::microseconds kWork(50);
+    const std::chrono::milliseconds kDuration(1500);
+
+    void work(std::chrono::microseconds duration)
+    {
+        Clock::time_point end = Clock::now() + duration;
+        while (Clock::now() < end)
+        {
+        }
+    }
+
+    // Lateness of every wake, in microseconds
+    class Lateness {
+    public:
+        void add(Clock::time_point due)
+        {
+            _latencies.add(std::chrono::duration<double, std::micro>(Clock::now() - due).count());
+        }
+        void report(const char *name, size_t players, size_t threads, const ofxHapBenchmarks::Switches& before, double seconds)
+        {
+            ofxHapBenchmarks::Switches after = ofxHapBenchmarks::switches();
+            double mean, p99, max;
+            _latencies.summarise(mean, p99, max);
+            std::printf("%-8s %3zu players %3zu threads: %7.0f switches/s (%5.0f involuntary), late mean %6.0fus p99 %6.0fus max %6.0fus\n",
+                        name, players, threads,
+                        (after.voluntary - before.voluntary + after.involuntary - before.involuntary) / seconds,
+                        (after.involuntary - before.involuntary) / seconds,
+                        mean, p99, max);
+        }
+    private:
+        ofxHapBenchmarks::Latencies _latencies;
+    };
+
+    // As each player's audio thread worked: sleep until due, work, repeat
+    void threads(size_t players)
+    {
+        Lateness lateness;
+        std::atomic<bool> finish(false);
+        std::mutex lock;
+        std::condition_variable condition;
+        std::vector<std::thread> threads;
+        ofxHapBenchmarks::Switches before = ofxHapBenchmarks::switches();
+        for (size_t i = 0; i < players; i++)
+        {
+            threads.emplace_back([&, i]() {
+                // Spread the players through the period
+                Clock::time_point due = Clock::now() + (kPeriod * i) / players;
+                std::unique_lock<std::mutex> locker(lock);
+                while (!finish)
+                {
+                    condition.wait_until(locker, due);
+                    if (Clock::now() >= due)
+                    {
+                        locker.unlock();
+                        lateness.add(due);
+                        work(kWork);
+                        due += kPeriod;
+                        locker.lock();
+                    }
+                }
+            });
+        }
+        std::this_thread::sleep_for(kDuration);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            finish = true;
+            condition.notify_all();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        lateness.report("threads", players, players, before, std::chrono::duration<double>(kDuration).count());
+    }
+
+    class Player : public ofxHap::DemuxPool::Task {
+    public:
+        Player(ofxHap::DemuxPool& p, Lateness& l, Clock::time_point d) : Task(true), pool(p), lateness(l), due(d) {}
+        virtual bool run() override
+        {
+            lateness.add(due);
+            work(kWork);
+            due += kPeriod;
+            pool.schedule(this, std::chrono::duration_cast<std::chrono::microseconds>(due - Clock::now()));
+            return false;
+        }
+        ofxHap::DemuxPool&  pool;
+        Lateness&           lateness;
+        Clock::time_point   due;
+    };
+
+    // As AudioThread works now: timers on a pool
+    void pool(size_t players)
+    {
+        std::shared_ptr<ofxHap::DemuxPool> pool = ofxHap::DemuxPool::audio();
+        size_t threads = std::max(2U, std::thread::hardware_concurrency() / 2);
+        Lateness lateness;
+        std::vector<std::unique_ptr<Player>> tasks;
+        ofxHapBenchmarks::Switches before = ofxHapBenchmarks::switches();
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < players; i++)
+        {
+            Clock::time_point due = start + (kPeriod * i) / players;
+            tasks.emplace_back(new Player(*pool, lateness, due));
+            pool->schedule(tasks.back().get(), std::chrono::duration_cast<std::chrono::microseconds>(due - Clock::now()));
+        }
+        std::this_thread::sleep_for(kDuration);
+        for (auto& task : tasks)
+        {
+            pool->remove(task.get());
+        }
+        lateness.report("pool", players, threads, before, std::chrono::duration<double>(kDuration).count());
+    }
+
+    class Blocking : public ofxHap::DemuxPool::Task {
+    public:
+        virtual bool run() override
+        {
+            // As avformat_open_input() waits on a slow disk or network
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            return false;
+        }
+    };
+
+    class Read : public ofxHap::DemuxPool::Task {
+    public:
+        Read() : ran(false) {}
+        virtual bool run() override
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ran = true;
+            condition.notify_one();
+            return false;
+        }
+        std::mutex              lock;
+        std::condition_variable condition;
+        bool                    ran;
+    };
+
+    void opens(bool separate)
+    {
+        std::shared_ptr<ofxHap::DemuxPool> reads = ofxHap::DemuxPool::shared();
+        std::shared_ptr<ofxHap::DemuxPool> opening = separate ? ofxHap::DemuxPool::opening() : reads;
+        const size_t kOpens = 16;
+        std::vector<std::unique_ptr<Blocking>> blocking;
+        for (size_t i = 0; i < kOpens; i++)
+        {
+            blocking.emplace_back(new Blocking());
+            opening->schedule(blocking.back().get());
+        }
+        Read read;
+        Clock::time_point start = Clock::now();
+        reads->schedule(&read);
+        {
+            std::unique_lock<std::mutex> locker(read.lock);
+            read.condition.wait(locker, [&read]() { return read.ran; });
+        }
+        double waited = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        for (auto& task : blocking)
+        {
+            opening->remove(task.get());
+        }
+        reads->remove(&read);
+        std::printf("read behind %zu opens on %s pool: waited %6.1fms\n", kOpens, separate ? "their own" : "the read", waited);
+    }
+}
+
+int main()
+{
+    for (size_t players : {10, 50, 100})
+    {
+        threads(players);
+        pool(players);
+    }
+    opens(false);
+    opens(true);
+    return EXIT_SUCCESS;
+}
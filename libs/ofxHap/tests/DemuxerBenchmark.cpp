@@ -0,0 +1,290 @@
+/*
+ DemuxerBenchmark.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/Demuxer.h>
+#include "Benchmark.h"
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <dirent.h>
+#endif
+
+/*
+ Plays a Hap movie with 10, 50 and 100 Demuxers at once, each from a different
+ place, reading ahead as the player does. Reports the threads the process
+ uses, context switches per second, and wake latency: how long after a read
+ is requested its first packets arrive.
+
+   DemuxerBenchmark movie.mov
+
+ Use a movie on the storage you play from. Once its pages are cached by the
+ system, reads measure the pool rather than the disk.
+ */
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    // As the player: read this far ahead of the playhead, topped up each update
+    const int64_t kReadAhead = 500000;
+    const int64_t kTopUp = 250000;
+    const std::chrono::microseconds kUpdate(16667);
+    const std::chrono::seconds kDuration(5);
+    const std::chrono::seconds kOpenTimeout(30);
+
+    double microseconds(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    }
+
+    // Threads in the process, or 0 if they can't be counted
+    size_t threads()
+    {
+        size_t count = 0;
+#if defined(__linux__)
+        DIR *dir = opendir("/proc/self/task");
+        if (dir)
+        {
+            while (struct dirent *entry = readdir(dir))
+            {
+                if (entry->d_name[0] != '.')
+                {
+                    count++;
+                }
+            }
+            closedir(dir);
+        }
+#endif
+        return count;
+    }
+
+    class Player : public ofxHap::PacketReceiver {
+    public:
+        Player(const std::string& movie, ofxHapBenchmarks::Latencies& latencies, double offset)
+        : _latencies(latencies), _offset(offset), _duration(0), _ready(false), _failed(false),
+        _readTo(-1), _waiting(false), _bytes(0)
+        {
+            // Once our members are initialised, as it calls us from the pool
+            _demuxer.reset(new ofxHap::Demuxer(movie, *this));
+        }
+        virtual void foundMovie(int64_t duration) override
+        {
+            _duration = duration;
+        }
+        virtual void foundStream(AVStream *stream) override
+        {
+
+        }
+        virtual void foundAllStreams() override
+        {
+            _ready = true;
+        }
+        virtual void readPacket(AVPacket *packet) override
+        {
+
+        }
+        virtual void readPackets(const std::vector<AVPacket *>& packets) override
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            for (auto packet : packets)
+            {
+                _bytes += packet->size;
+            }
+            if (_waiting)
+            {
+                _latencies.add(microseconds(Clock::now() - _requested));
+                _waiting = false;
+            }
+        }
+        virtual void discontinuity() override
+        {
+
+        }
+        virtual void endMovie() override
+        {
+
+        }
+        virtual void error(int averror) override
+        {
+            _failed = true;
+        }
+        bool isReady() const
+        {
+            return _ready;
+        }
+        bool hasFailed() const
+        {
+            return _failed;
+        }
+        int64_t getBytes() const
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            return _bytes;
+        }
+        // Read ahead of where we would be after elapsed microseconds of looped playback
+        void update(int64_t elapsed)
+        {
+            int64_t duration = _duration;
+            if (duration <= 0)
+            {
+                return;
+            }
+            // Positions count up through each loop, rather than wrapping
+            int64_t position = static_cast<int64_t>(_offset * duration) + elapsed;
+            if (_readTo >= position + kReadAhead - kTopUp)
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(_lock);
+                if (!_waiting)
+                {
+                    _waiting = true;
+                    _requested = Clock::now();
+                }
+            }
+            int64_t from = std::max(_readTo, position);
+            int64_t to = position + kReadAhead;
+            while (from < to)
+            {
+                // Up to the end of the movie, then from its start
+                int64_t start = from % duration;
+                int64_t end = std::min(start + to - from, duration);
+                if (from != _readTo || start == 0)
+                {
+                    _demuxer->seekTime(start, true);
+                }
+                _demuxer->read(end - 1, true);
+                from += end - start;
+                _readTo = from;
+            }
+        }
+    private:
+        ofxHapBenchmarks::Latencies&    _latencies;
+        const double                    _offset; // where we start, as a fraction of the movie
+        std::atomic<int64_t>            _duration;
+        std::atomic<bool>               _ready;
+        std::atomic<bool>               _failed;
+        int64_t                         _readTo; // only used from update()
+        mutable std::mutex              _lock;
+        bool                            _waiting; // for the first packets since _requested
+        Clock::time_point               _requested;
+        int64_t                         _bytes;
+        std::unique_ptr<ofxHap::Demuxer> _demuxer; // last, so it is destroyed first
+    };
+
+    bool run(const std::string& movie, size_t count)
+    {
+        ofxHapBenchmarks::Latencies latencies;
+        std::vector<std::unique_ptr<Player>> players;
+        for (size_t i = 0; i < count; i++)
+        {
+            players.emplace_back(new Player(movie, latencies, i / static_cast<double>(count)));
+        }
+        Clock::time_point deadline = Clock::now() + kOpenTimeout;
+        size_t ready = 0;
+        while (ready < count && Clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            ready = 0;
+            for (const auto& player : players)
+            {
+                if (player->hasFailed())
+                {
+                    std::fprintf(stderr, "couldn't open %s\n", movie.c_str());
+                    return false;
+                }
+                ready += player->isReady() ? 1 : 0;
+            }
+        }
+        if (ready < count)
+        {
+            std::fprintf(stderr, "timed out opening %s\n", movie.c_str());
+            return false;
+        }
+
+        ofxHapBenchmarks::Switches before = ofxHapBenchmarks::switches();
+        Clock::time_point start = Clock::now();
+        Clock::time_point next = start;
+        size_t peakThreads = 0;
+        while (Clock::now() - start < kDuration)
+        {
+            int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+            for (const auto& player : players)
+            {
+                player->update(elapsed);
+            }
+            peakThreads = std::max(peakThreads, threads());
+            next += kUpdate;
+            std::this_thread::sleep_until(next);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        ofxHapBenchmarks::Switches after = ofxHapBenchmarks::switches();
+        int64_t bytes = 0;
+        for (const auto& player : players)
+        {
+            bytes += player->getBytes();
+        }
+        players.clear();
+
+        double mean, p99, max;
+        latencies.summarise(mean, p99, max);
+        std::printf("%3zu demuxers %3zu threads: %7.0f switches/s (%5.0f involuntary), %6.1f MB/s, wake latency mean %6.0fus p99 %6.0fus max %6.0fus\n",
+                    count, peakThreads,
+                    (after.voluntary - before.voluntary + after.involuntary - before.involuntary) / seconds,
+                    (after.involuntary - before.involuntary) / seconds,
+                    bytes / seconds / 1000000.0,
+                    mean, p99, max);
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::fprintf(stderr, "usage: %s movie\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (size_t count : {10, 50, 100})
+    {
+        if (!run(argv[1], count))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
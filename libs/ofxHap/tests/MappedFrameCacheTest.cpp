@@ -0,0 +1,297 @@
+/*
+ MappedFrameCacheTest.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/MappedFrameCache.h>
+#include "Check.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ Checks the on-disk frame cache: storing and reopening, sharing within a
+ process, storing from several threads at once, locking against other processes, what survives a process which
+ exits without closing the cache, and keeping a directory within a limit.
+ */
+
+namespace {
+    const size_t kFrameSize = 8192;
+    const int64_t kFrameCount = 64;
+    const int64_t kDuration = 100;
+    const uint32_t kFormat = 1;
+    const int64_t kNoLimit = INT64_MAX;
+
+    std::string directory;
+
+    std::string path(const char *name)
+    {
+        return directory + "/" + name + ".hapcache";
+    }
+
+    bool exists(const std::string& path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0;
+    }
+
+    std::vector<char> frame(int64_t index)
+    {
+        return std::vector<char>(kFrameSize, static_cast<char>(index + 1));
+    }
+
+    std::shared_ptr<ofxHap::MappedFrameCache> open(const std::string& path, int64_t limit = kNoLimit)
+    {
+        return ofxHap::MappedFrameCache::open(path, kFrameSize, kFrameCount, kFormat, limit);
+    }
+
+    void store(ofxHap::MappedFrameCache& cache, int64_t first, int64_t count)
+    {
+        for (int64_t i = first; i < first + count; i++)
+        {
+            cache.store(i * kDuration, kDuration, frame(i).data());
+        }
+    }
+
+    // Returns how many frames from the start are present and correct, checking none follow
+    int64_t stored(const ofxHap::MappedFrameCache& cache)
+    {
+        int64_t count = 0;
+        for (int64_t i = 0; i < kFrameCount; i++)
+        {
+            int64_t start, duration;
+            const char *data = cache.fetch(i * kDuration + 1, start, duration);
+            if (data)
+            {
+                if (count != i || start != i * kDuration || duration != kDuration ||
+                    std::memcmp(data, frame(i).data(), kFrameSize) != 0)
+                {
+                    return -1;
+                }
+                count++;
+            }
+        }
+        return count;
+    }
+
+    void testStoreAndReopen()
+    {
+        std::string file = path("reopen");
+        {
+            auto cache = open(file);
+            CHECK(cache != nullptr);
+            if (!cache)
+                return;
+            CHECK(stored(*cache) == 0);
+            store(*cache, 0, 10);
+            CHECK(stored(*cache) == 10);
+            // Storing a frame again, or past the end, changes nothing
+            cache->store(0, kDuration, frame(5).data());
+            CHECK(stored(*cache) == 10);
+            // Players of the same movie share the cache
+            CHECK(open(file) == cache);
+            // But not with a different layout
+            CHECK(ofxHap::MappedFrameCache::open(file, kFrameSize * 2, kFrameCount, kFormat, kNoLimit) == nullptr);
+        }
+        auto cache = open(file);
+        CHECK(cache != nullptr);
+        if (cache)
+        {
+            CHECK(stored(*cache) == 10);
+        }
+        // A different format starts again
+        cache.reset();
+        cache = ofxHap::MappedFrameCache::open(file, kFrameSize, kFrameCount, kFormat + 1, kNoLimit);
+        CHECK(cache != nullptr && stored(*cache) == 0);
+    }
+
+    void testConcurrentStores()
+    {
+        std::string file = path("concurrent");
+        {
+            auto cache = open(file);
+            CHECK(cache != nullptr);
+            if (!cache)
+                return;
+            // Frames are copied in without the lock, so check a fetch never sees one part-copied
+            const int kThreads = 4;
+            std::vector<std::thread> threads;
+            for (int t = 0; t < kThreads; t++)
+            {
+                threads.emplace_back([&cache, t]() {
+                    for (int64_t i = t; i < kFrameCount; i += kThreads)
+                    {
+                        cache->store(i * kDuration, kDuration, frame(i).data());
+                    }
+                });
+            }
+            bool valid = true;
+            for (int pass = 0; pass < 100; pass++)
+            {
+                for (int64_t i = 0; i < kFrameCount; i++)
+                {
+                    int64_t start, duration;
+                    const char *data = cache->fetch(i * kDuration, start, duration);
+                    if (data && std::memcmp(data, frame(i).data(), kFrameSize) != 0)
+                    {
+                        valid = false;
+                    }
+                }
+            }
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+            CHECK(valid);
+            CHECK(stored(*cache) == kFrameCount);
+        }
+        auto cache = open(file);
+        CHECK(cache != nullptr && stored(*cache) == kFrameCount);
+    }
+
+    std::string executable;
+
+    // Runs this test in another process with the given command, returning its exit status
+    int child(const char *command, const std::string& file)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            execl(executable.c_str(), executable.c_str(), command, file.c_str(), static_cast<char *>(nullptr));
+            _exit(127);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    int childMain(const std::string& command, const std::string& file)
+    {
+        auto cache = open(file);
+        if (!cache)
+        {
+            return 1;
+        }
+        if (command == "crash")
+        {
+            // Exit without closing the cache, after giving the pool time to
+            // flush the frames it has been asked to
+            store(*cache, 0, 40);
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            store(*cache, 40, 8);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        return 0;
+    }
+
+    void testProcessLock()
+    {
+        std::string file = path("lock");
+        auto cache = open(file);
+        CHECK(cache != nullptr);
+        CHECK(child("open", file) == 1);
+        cache.reset();
+        CHECK(child("open", file) == 0);
+    }
+
+    void testUncleanExit()
+    {
+        std::string file = path("crash");
+        CHECK(child("crash", file) == 0);
+        auto cache = open(file);
+        CHECK(cache != nullptr);
+        if (cache)
+        {
+            // Only flushed frames are recorded, and all of them are intact
+            int64_t count = stored(*cache);
+            CHECK(count >= 32 && count <= 40);
+        }
+    }
+
+    void testLimit()
+    {
+        // Away from the other tests' files
+        directory += "/limit";
+        mkdir(directory.c_str(), 0755);
+        std::string a = path("a");
+        std::string b = path("b");
+        std::string c = path("c");
+        open(a);
+        open(b);
+        CHECK(exists(a) && exists(b));
+        // Every file is this size, including its header
+        struct stat info;
+        stat(a.c_str(), &info);
+        const int64_t size = info.st_size;
+        CHECK(size > static_cast<int64_t>(kFrameSize * kFrameCount));
+        // Too big for the limit, which leaves the others alone
+        CHECK(open(c, size - 1) == nullptr);
+        CHECK(exists(a) && exists(b) && !exists(c));
+        // Evicts the least recently used, which is by the second
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        open(a);
+        auto cacheC = open(c, size * 2);
+        CHECK(cacheC != nullptr);
+        CHECK(exists(a) && !exists(b) && exists(c));
+        // Files in use aren't evicted
+        auto cacheA = open(a);
+        CHECK(open(b, size * 2) == nullptr);
+        CHECK(exists(a) && !exists(b) && exists(c));
+        cacheC.reset();
+        CHECK(open(b, size * 2) != nullptr);
+        CHECK(exists(a) && exists(b) && !exists(c));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3)
+    {
+        return childMain(argv[1], argv[2]);
+    }
+    executable = argv[0];
+    char temp[] = "/tmp/ofxHapFrameCacheXXXXXX";
+    if (!mkdtemp(temp))
+    {
+        std::perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    directory = temp;
+    testStoreAndReopen();
+    testConcurrentStores();
+    testProcessLock();
+    testUncleanExit();
+    testLimit();
+    std::system((std::string("rm -rf ") + temp).c_str());
+    return ofxHapTests::finish();
+}
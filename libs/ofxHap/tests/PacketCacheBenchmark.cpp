@@ -0,0 +1,179 @@
+/*
+ PacketCacheBenchmark.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/PacketCache.h>
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ Measures contention between threads storing packets and the thread
+ fetching them, for LockingPacketCache and for a PacketCache behind a
+ mutex, which is how the cache was shared before. The fetching thread
+ takes in everything stored, so the cost per packet on that thread is
+ reported along with the latency of each fetch.
+ */
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const int64_t kDuration = 10;
+    const int kPerProducer = 20000;
+
+    class MutexPacketCache {
+    public:
+        void store(const std::vector<AVPacket *>& packets)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            for (auto packet : packets)
+            {
+                _cache.store(packet);
+            }
+        }
+        bool fetch(int64_t pts, AVPacket *p)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            AVPacket *found = _cache.fetch(pts);
+            if (found)
+            {
+                av_packet_ref(p, found);
+            }
+            return found != nullptr;
+        }
+        void limit(const ofxHap::TimeRangeSet& ranges)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _cache.limit(ranges);
+        }
+    private:
+        std::mutex _lock;
+        ofxHap::PacketCache _cache;
+    };
+
+    struct Result {
+        double storeRate;  // packets per second
+        double fetchMean;  // ns
+        double fetchMax;   // ns
+        double consumer;   // ns of fetching and trimming per packet stored
+    };
+
+    template <class C>
+    Result run(int producers, size_t batchSize)
+    {
+        C cache;
+        std::atomic<int> finished(0);
+        std::vector<std::thread> threads;
+        Clock::time_point start = Clock::now();
+        for (int p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&cache, &finished, p, producers, batchSize]() {
+                std::vector<AVPacket *> batch;
+                for (int i = 0; i < kPerProducer; i++)
+                {
+                    AVPacket *packet = av_packet_alloc();
+                    av_new_packet(packet, 1024);
+                    packet->pts = (int64_t(i) * producers + p) * kDuration;
+                    packet->duration = kDuration;
+                    batch.push_back(packet);
+                    if (batch.size() == batchSize)
+                    {
+                        cache.store(batch);
+                        for (auto b : batch)
+                        {
+                            av_packet_free(&b);
+                        }
+                        batch.clear();
+                    }
+                }
+                finished++;
+            });
+        }
+        // Fetch and trim as a player's update would, as fast as possible
+        double total = 0, longest = 0;
+        int64_t fetches = 0;
+        AVPacket *packet = av_packet_alloc();
+        while (finished.load() < producers)
+        {
+            int64_t pts = fetches % (kPerProducer * producers) * kDuration;
+            Clock::time_point before = Clock::now();
+            if (cache.fetch(pts, packet))
+            {
+                av_packet_unref(packet);
+            }
+            if (fetches % 64 == 0)
+            {
+                ofxHap::TimeRangeSet ranges;
+                ranges.add(pts, 1000 * kDuration);
+                cache.limit(ranges);
+            }
+            double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - before).count();
+            total += elapsed;
+            longest = std::max(longest, elapsed);
+            fetches++;
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        av_packet_free(&packet);
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        Result result;
+        result.storeRate = kPerProducer * producers / seconds;
+        result.fetchMean = fetches ? total / fetches : 0;
+        result.fetchMax = longest;
+        result.consumer = total / (kPerProducer * producers);
+        return result;
+    }
+
+    template <class C>
+    void report(const char *name, int producers, size_t batchSize)
+    {
+        Result r = run<C>(producers, batchSize);
+        std::printf("%-6s %d producers, batch %2zu: %5.2fM stores/s, fetch mean %9.0fns max %9.0fns, consumer %5.0fns/packet\n",
+                    name, producers, batchSize, r.storeRate / 1e6, r.fetchMean, r.fetchMax, r.consumer);
+    }
+}
+
+int main()
+{
+    for (int producers : {1, 2, 4, 8})
+    {
+        for (size_t batch : {size_t(1), size_t(8)})
+        {
+            report<MutexPacketCache>("mutex", producers, batch);
+            report<ofxHap::LockingPacketCache>("inbox", producers, batch);
+        }
+    }
+    return EXIT_SUCCESS;
+}
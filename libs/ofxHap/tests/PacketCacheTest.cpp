@@ -0,0 +1,239 @@
+/*
+ PacketCacheTest.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/PacketCache.h>
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include "Check.h"
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ Checks LockingPacketCache on one thread, then stresses it with several
+ threads storing while one fetches. Build with OFXHAP_SANITIZE=thread to
+ run the stress under ThreadSanitizer.
+ */
+
+namespace {
+    const int64_t kDuration = 10;
+
+    // A packet whose data holds its pts
+    AVPacket *makePacket(int64_t pts)
+    {
+        AVPacket *packet = av_packet_alloc();
+        av_new_packet(packet, sizeof(int64_t));
+        std::memcpy(packet->data, &pts, sizeof(int64_t));
+        packet->pts = pts;
+        packet->duration = kDuration;
+        return packet;
+    }
+
+    // A packet which can't be cloned: FFmpeg won't copy an unreferenced packet of negative size
+    AVPacket *makeBadPacket(int64_t pts)
+    {
+        AVPacket *packet = av_packet_alloc();
+        packet->pts = pts;
+        packet->duration = kDuration;
+        packet->size = -1;
+        return packet;
+    }
+
+    void freePackets(std::vector<AVPacket *>& packets)
+    {
+        for (auto packet : packets)
+        {
+            av_packet_free(&packet);
+        }
+        packets.clear();
+    }
+
+    bool fetches(ofxHap::LockingPacketCache& cache, int64_t pts)
+    {
+        AVPacket *packet = av_packet_alloc();
+        bool found = cache.fetch(pts + kDuration / 2, packet);
+        if (found)
+        {
+            int64_t stored;
+            std::memcpy(&stored, packet->data, sizeof(int64_t));
+            found = stored == pts;
+        }
+        av_packet_free(&packet);
+        return found;
+    }
+
+    // Ranges which exclude everything stored below, but start before it,
+    // so they keep the active set and empty the cache
+    ofxHap::TimeRangeSet activeOnly()
+    {
+        ofxHap::TimeRangeSet ranges;
+        ranges.add(0, 50);
+        ranges.add(1000, 100);
+        return ranges;
+    }
+
+    void testCacheMarker()
+    {
+        ofxHap::LockingPacketCache cache;
+        std::vector<AVPacket *> packets{makePacket(100)};
+        cache.store(packets[0]);
+        cache.cache();
+        CHECK(fetches(cache, 100));
+        cache.limit(activeOnly());
+        CHECK(!fetches(cache, 100));
+        freePackets(packets);
+    }
+
+    void testFailedClone()
+    {
+        ofxHap::LockingPacketCache cache;
+        std::vector<AVPacket *> packets{makePacket(100), makeBadPacket(110)};
+        cache.store(packets[0]);
+        cache.store(packets[1]);
+        // A failed store must not move the active set to the cache
+        cache.limit(activeOnly());
+        CHECK(fetches(cache, 100));
+        CHECK(!fetches(cache, 110));
+        freePackets(packets);
+    }
+
+    void testFailedCloneInBatch()
+    {
+        ofxHap::LockingPacketCache cache;
+        std::vector<AVPacket *> packets{makeBadPacket(100), makePacket(110), makeBadPacket(120), makePacket(130), makeBadPacket(140)};
+        cache.store(packets);
+        cache.limit(activeOnly());
+        CHECK(fetches(cache, 110));
+        CHECK(fetches(cache, 130));
+        CHECK(!fetches(cache, 100));
+        CHECK(!fetches(cache, 120));
+        CHECK(!fetches(cache, 140));
+        freePackets(packets);
+
+        // A batch which stores nothing, then one which reuses its nodes
+        packets = {makeBadPacket(200), makeBadPacket(210)};
+        cache.store(packets);
+        freePackets(packets);
+        packets = {makePacket(200), makePacket(210), makePacket(220)};
+        cache.store(packets);
+        cache.limit(activeOnly());
+        CHECK(fetches(cache, 200));
+        CHECK(fetches(cache, 210));
+        CHECK(fetches(cache, 220));
+        CHECK(fetches(cache, 110));
+        freePackets(packets);
+
+        cache.clear();
+        CHECK(cache.getBytes() == 0);
+    }
+
+    void testStress()
+    {
+        const int kProducers = 4;
+        const int kPerProducer = 5000;
+        ofxHap::LockingPacketCache cache;
+        std::vector<std::thread> producers;
+        for (int p = 0; p < kProducers; p++)
+        {
+            producers.emplace_back([&cache, p]() {
+                std::vector<AVPacket *> batch;
+                unsigned int seed = p + 1;
+                for (int i = 0; i < kPerProducer; i++)
+                {
+                    int64_t pts = (int64_t(i) * kProducers + p) * kDuration;
+                    batch.push_back(makePacket(pts));
+                    seed = seed * 1103515245 + 12345;
+                    unsigned int roll = (seed >> 16) % 16;
+                    if (roll == 0)
+                    {
+                        batch.push_back(makeBadPacket(pts + 1));
+                    }
+                    if (roll < 4 || i == kPerProducer - 1)
+                    {
+                        if (batch.size() == 1)
+                        {
+                            cache.store(batch[0]);
+                        }
+                        else
+                        {
+                            cache.store(batch);
+                        }
+                        freePackets(batch);
+                    }
+                    if (roll == 5)
+                    {
+                        cache.cache();
+                    }
+                }
+            });
+        }
+        // Fetch every packet in order, trimming what has been passed
+        int missing = 0;
+        AVPacket *packet = av_packet_alloc();
+        for (int64_t i = 0; i < kPerProducer * kProducers; i++)
+        {
+            int64_t pts = i * kDuration;
+            if (cache.fetch(pts + kDuration / 2, packet, std::chrono::seconds(5)))
+            {
+                int64_t stored;
+                std::memcpy(&stored, packet->data, sizeof(int64_t));
+                CHECK(stored == pts);
+                av_packet_unref(packet);
+            }
+            else
+            {
+                missing++;
+            }
+            if (i % 64 == 0)
+            {
+                ofxHap::TimeRangeSet ranges;
+                ranges.add(pts, INT64_MAX / 2);
+                cache.limit(ranges);
+            }
+        }
+        av_packet_free(&packet);
+        for (auto& producer : producers)
+        {
+            producer.join();
+        }
+        CHECK(missing == 0);
+        cache.clear();
+        CHECK(cache.getBytes() == 0);
+    }
+}
+
+int main()
+{
+    testCacheMarker();
+    testFailedClone();
+    testFailedCloneInBatch();
+    testStress();
+    return ofxHapTests::finish();
+}
@@ -0,0 +1,146 @@
+/*
+ TimeRangeSetBenchmark.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/TimeRangeSet.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ Times the range work one player update() does: the read-ahead, cache and
+ pinned windows, trimming the active set, and the prefetch bookkeeping.
+ Each case is timed with the movie playing through a loop point, so the
+ windows wrap into two ranges. The "stride" case reads every fourth frame,
+ as at high speeds, so its sets outgrow the four ranges held inline.
+ */
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const int64_t kDuration = 60000000; // a one minute loop, in microseconds
+    const int64_t kFrame = 16683;
+    const int64_t kAhead = 500000;
+    const int64_t kBehind = 250000;
+
+    // The ranges covering duration from position, wrapping at the loop
+    ofxHap::TimeRangeSequence window(int64_t position, int64_t duration)
+    {
+        ofxHap::TimeRangeSequence sequence;
+        position %= kDuration;
+        if (position < 0)
+        {
+            position += kDuration;
+        }
+        int64_t first = std::min(duration, kDuration - position);
+        sequence.add(ofxHap::TimeRange(position, first));
+        if (first < duration)
+        {
+            sequence.add(ofxHap::TimeRange(0, duration - first));
+        }
+        return sequence;
+    }
+
+    ofxHap::TimeRangeSequence strided(const ofxHap::TimeRangeSequence& sequence, int stride)
+    {
+        ofxHap::TimeRangeSequence frames;
+        for (const auto& range : sequence)
+        {
+            for (int64_t t = range.start; t <= range.latest(); t += kFrame * stride)
+            {
+                frames.add(ofxHap::TimeRange(t, kFrame));
+            }
+        }
+        return frames;
+    }
+
+    struct Player {
+        ofxHap::TimeRangeSet active;
+        ofxHap::TimeRangeSet prefetched;
+        int64_t checksum = 0;
+
+        void update(int64_t position, int stride)
+        {
+            ofxHap::TimeRangeSequence future = window(position, kAhead);
+            ofxHap::TimeRangeSequence cache = window(position - kBehind, kBehind + kAhead);
+            ofxHap::TimeRangeSet keep(cache);
+
+            // The loop start is kept ready
+            ofxHap::TimeRangeSequence pinned;
+            pinned.add(ofxHap::TimeRange(0, kFrame * 8));
+            ofxHap::TimeRangeSet pinnedSet(pinned);
+            for (const auto& range : pinnedSet)
+            {
+                keep.add(range);
+            }
+
+            active = active.intersection(keep);
+
+            // Read what isn't already active
+            ofxHap::TimeRangeSequence wanted = stride > 1 ? strided(future, stride) : future;
+            wanted.remove(active);
+            for (const auto& range : wanted)
+            {
+                active.add(range);
+            }
+
+            // Prefetch what is coming soon, once
+            ofxHap::TimeRangeSequence soon = window(position, kAhead / 2);
+            soon.remove(prefetched);
+            for (const auto& range : soon)
+            {
+                prefetched.add(range);
+            }
+            prefetched = prefetched.intersection(future);
+
+            checksum += active.size() + prefetched.size();
+        }
+    };
+
+    void run(const char *name, int stride)
+    {
+        const int kUpdates = 200000;
+        Player player;
+        // Start a second before the loop point so updates cross it
+        int64_t position = kDuration - 1000000;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < kUpdates; i++)
+        {
+            player.update(position, stride);
+            position = (position + kFrame) % kDuration;
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kUpdates;
+        std::printf("%-8s %6.0f ns per update (checksum %lld)\n", name, ns, (long long)player.checksum);
+    }
+}
+
+int main()
+{
+    run("normal", 1);
+    run("stride", 4);
+    return EXIT_SUCCESS;
+}
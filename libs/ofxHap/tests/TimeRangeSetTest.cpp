@@ -0,0 +1,378 @@
+/*
+ TimeRangeSetTest.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ofxHap/TimeRangeSet.h>
+#include "Check.h"
+#include <bitset>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+    typedef std::vector<std::pair<int64_t, int64_t>> Ranges;
+
+    template <class T>
+    Ranges ranges(const T& set)
+    {
+        Ranges result;
+        for (const auto& range : set)
+        {
+            result.emplace_back(range.start, range.length);
+        }
+        return result;
+    }
+
+    template <class T>
+    void print(const char *label, const T& set)
+    {
+        std::fprintf(stderr, "  %s:", label);
+        for (const auto& range : set)
+        {
+            std::fprintf(stderr, " (%lld, %lld)", (long long)range.start, (long long)range.length);
+        }
+        std::fprintf(stderr, "\n");
+    }
+
+#define CHECK_RANGES(set, ...) do { \
+    Ranges expected = __VA_ARGS__; \
+    if (ranges(set) != expected) { \
+        std::fprintf(stderr, "%s:%d: unexpected ranges in %s\n", __FILE__, __LINE__, #set); \
+        print("got", set); \
+        ofxHapTests::fail(); \
+    } \
+} while (0)
+
+    ofxHap::TimeRangeSet makeSet(std::initializer_list<std::pair<int64_t, int64_t>> list)
+    {
+        ofxHap::TimeRangeSet set;
+        for (const auto& range : list)
+        {
+            set.add(range.first, range.second);
+        }
+        return set;
+    }
+
+    ofxHap::TimeRangeSequence makeSequence(std::initializer_list<std::pair<int64_t, int64_t>> list)
+    {
+        ofxHap::TimeRangeSequence sequence;
+        for (const auto& range : list)
+        {
+            sequence.add(ofxHap::TimeRange(range.first, range.second));
+        }
+        return sequence;
+    }
+
+    void testRange()
+    {
+        ofxHap::TimeRange forward(10, 5);
+        CHECK(forward.earliest() == 10);
+        CHECK(forward.latest() == 14);
+        CHECK(forward.includes(10) && forward.includes(14));
+        CHECK(!forward.includes(9) && !forward.includes(15));
+
+        ofxHap::TimeRange backward(14, -5);
+        CHECK(backward.earliest() == 10);
+        CHECK(backward.latest() == 14);
+        CHECK(backward.abs().start == 10 && backward.abs().length == 5);
+
+        CHECK(forward.intersects(ofxHap::TimeRange(14, 1)));
+        CHECK(!forward.intersects(ofxHap::TimeRange(15, 1)));
+        CHECK(forward.intersects(ofxHap::TimeRange(0, 100)));
+        ofxHap::TimeRange i = forward.intersection(ofxHap::TimeRange(12, 10));
+        CHECK(i.start == 12 && i.length == 3);
+        CHECK(forward.intersection(ofxHap::TimeRange(20, 10)).length == 0);
+
+        ofxHap::TimeRange r(10, 5);
+        r.setEarliest(12);
+        CHECK(r.start == 12 && r.length == 3);
+        r.setLatest(20);
+        CHECK(r.start == 12 && r.length == 9);
+        ofxHap::TimeRange b(14, -5);
+        b.setEarliest(12);
+        CHECK(b.earliest() == 12 && b.latest() == 14);
+        b.setLatest(13);
+        CHECK(b.earliest() == 12 && b.latest() == 13);
+    }
+
+    void testAdd()
+    {
+        ofxHap::TimeRangeSet set;
+        set.add(0, 0);
+        CHECK(set.size() == 0);
+
+        // Out of order, and normalised
+        set = makeSet({{20, 5}, {0, 5}, {14, -5}});
+        CHECK_RANGES(set, {{0, 5}, {10, 5}, {20, 5}});
+        CHECK(set.earliest() == 0);
+        CHECK(set.latest() == 24);
+
+        // Adjacent on either side merges
+        set.add(5, 1);
+        CHECK_RANGES(set, {{0, 6}, {10, 5}, {20, 5}});
+        set.add(9, 1);
+        CHECK_RANGES(set, {{0, 6}, {9, 6}, {20, 5}});
+
+        // Overlapping merges
+        set.add(12, 5);
+        CHECK_RANGES(set, {{0, 6}, {9, 8}, {20, 5}});
+
+        // A range reaching later ones absorbs them all
+        set = makeSet({{0, 5}, {10, 5}, {20, 5}, {30, 5}});
+        set.add(3, 20);
+        CHECK_RANGES(set, {{0, 25}, {30, 5}});
+        set.add(25, 5);
+        CHECK_RANGES(set, {{0, 35}});
+
+        // Inside an existing range
+        set.add(5, 5);
+        CHECK_RANGES(set, {{0, 35}});
+
+        CHECK(set.includes(34) && !set.includes(35));
+        set.clear();
+        CHECK(set.size() == 0);
+    }
+
+    void testRemove()
+    {
+        ofxHap::TimeRangeSet set = makeSet({{0, 10}, {20, 10}});
+        set.remove(0, 0);
+        CHECK_RANGES(set, {{0, 10}, {20, 10}});
+
+        // Start, end and whole
+        set.remove(0, 2);
+        CHECK_RANGES(set, {{2, 8}, {20, 10}});
+        set.remove(8, 5);
+        CHECK_RANGES(set, {{2, 6}, {20, 10}});
+        set.remove(2, 6);
+        CHECK_RANGES(set, {{20, 10}});
+
+        // A split keeps the remainder after the range
+        set = makeSet({{0, 10}, {20, 10}});
+        set.remove(3, 2);
+        CHECK_RANGES(set, {{0, 3}, {5, 5}, {20, 10}});
+        CHECK(set.latest() == 29);
+        set.remove(24, 2);
+        CHECK_RANGES(set, {{0, 3}, {5, 5}, {20, 4}, {26, 4}});
+        CHECK(set.latest() == 29);
+
+        // Across several, and backwards
+        set.remove(ofxHap::TimeRange(25, -24));
+        CHECK_RANGES(set, {{0, 2}, {26, 4}});
+
+        set = makeSet({{0, 10}, {20, 10}, {40, 10}});
+        set.remove(makeSet({{5, 20}, {45, 1}}));
+        CHECK_RANGES(set, {{0, 5}, {25, 5}, {40, 5}, {46, 4}});
+    }
+
+    void testIntersection()
+    {
+        ofxHap::TimeRangeSet a = makeSet({{0, 10}, {20, 10}});
+        ofxHap::TimeRangeSet b = makeSet({{5, 20}, {28, 10}});
+        CHECK_RANGES(a.intersection(b), {{5, 5}, {20, 5}, {28, 2}});
+        CHECK(a.intersection(ofxHap::TimeRangeSet()).size() == 0);
+
+        ofxHap::TimeRangeSequence sequence = makeSequence({{25, 10}, {9, -5}});
+        CHECK_RANGES(a.intersection(sequence), {{5, 5}, {25, 5}});
+    }
+
+    void testSequence()
+    {
+        ofxHap::TimeRangeSequence sequence = makeSequence({{50, 10}, {0, 10}});
+        CHECK_RANGES(sequence, {{50, 10}, {0, 10}});
+        CHECK_RANGES(ofxHap::TimeRangeSet(sequence), {{0, 10}, {50, 10}});
+
+        // Going forwards the remainder of a split follows the range
+        sequence.remove(ofxHap::TimeRange(53, 2));
+        CHECK_RANGES(sequence, {{50, 3}, {55, 5}, {0, 10}});
+
+        // Going backwards it comes first
+        sequence = makeSequence({{59, -10}, {9, -10}});
+        sequence.remove(ofxHap::TimeRange(53, 2));
+        CHECK_RANGES(sequence, {{59, -5}, {52, -3}, {9, -10}});
+
+        // Trimming either end
+        sequence = makeSequence({{0, 10}, {29, -10}});
+        sequence.remove(ofxHap::TimeRange(0, 3));
+        sequence.remove(ofxHap::TimeRange(27, 5));
+        CHECK_RANGES(sequence, {{3, 7}, {26, -7}});
+        sequence.remove(ofxHap::TimeRange(8, 5));
+        sequence.remove(ofxHap::TimeRange(15, 6));
+        CHECK_RANGES(sequence, {{3, 5}, {26, -6}});
+
+        sequence.remove(makeSet({{0, 100}}));
+        CHECK(sequence.size() == 0);
+    }
+
+    // Sets of four ranges are held inline, and larger ones on the heap
+    void testStorage()
+    {
+        ofxHap::TimeRangeSet set = makeSet({{0, 1}, {10, 1}, {20, 1}, {30, 1}});
+        CHECK(set.size() == 4);
+        set.add(40, 1);
+        CHECK_RANGES(set, {{0, 1}, {10, 1}, {20, 1}, {30, 1}, {40, 1}});
+        // Inserting at the front as the set grows past four moves every range
+        ofxHap::TimeRangeSet front = makeSet({{10, 1}, {20, 1}, {30, 1}, {40, 1}});
+        front.add(0, 1);
+        CHECK_RANGES(front, {{0, 1}, {10, 1}, {20, 1}, {30, 1}, {40, 1}});
+        // A split which grows the set past four
+        ofxHap::TimeRangeSet split = makeSet({{0, 10}, {20, 1}, {30, 1}, {40, 1}});
+        split.remove(5, 1);
+        CHECK_RANGES(split, {{0, 5}, {6, 4}, {20, 1}, {30, 1}, {40, 1}});
+        // And shrinking back keeps working from the heap
+        split.remove(0, 35);
+        CHECK_RANGES(split, {{40, 1}});
+        split.add(50, 1);
+        CHECK_RANGES(split, {{40, 1}, {50, 1}});
+
+        // Copies and moves of inline and heap storage
+        ofxHap::TimeRangeSet small = makeSet({{0, 1}, {10, 1}});
+        ofxHap::TimeRangeSet copy(set);
+        CHECK_RANGES(copy, {{0, 1}, {10, 1}, {20, 1}, {30, 1}, {40, 1}});
+        copy = small;
+        CHECK_RANGES(copy, {{0, 1}, {10, 1}});
+        copy = set;
+        CHECK_RANGES(copy, {{0, 1}, {10, 1}, {20, 1}, {30, 1}, {40, 1}});
+        const ofxHap::TimeRangeSet& self = copy;
+        copy = self;
+        CHECK(copy.size() == 5);
+
+        ofxHap::TimeRangeSet moved(std::move(copy));
+        CHECK_RANGES(moved, {{0, 1}, {10, 1}, {20, 1}, {30, 1}, {40, 1}});
+        CHECK(copy.size() == 0);
+        copy.add(0, 1);
+        CHECK_RANGES(copy, {{0, 1}});
+        moved = std::move(small);
+        CHECK_RANGES(moved, {{0, 1}, {10, 1}});
+        CHECK(small.size() == 0);
+        moved = std::move(set);
+        CHECK(moved.size() == 5);
+        CHECK(set.size() == 0);
+        set.add(5, 1);
+        CHECK_RANGES(set, {{5, 1}});
+    }
+
+    // Random operations checked against a bitmap of which times are included
+    void testRandom()
+    {
+        const int kSpan = 128;
+        typedef std::bitset<kSpan> Bits;
+        std::mt19937 random(45);
+        std::uniform_int_distribution<int> position(0, kSpan - 1);
+        std::uniform_int_distribution<int> operation(0, 3);
+        auto randomRange = [&]() {
+            int a = position(random);
+            int b = position(random);
+            int64_t length = std::abs(b - a) + 1;
+            return a <= b ? ofxHap::TimeRange(a, length) : ofxHap::TimeRange(a, -length);
+        };
+        auto bits = [](const ofxHap::TimeRange& range) {
+            Bits result;
+            for (int64_t t = range.earliest(); t <= range.latest(); t++)
+            {
+                result.set(t);
+            }
+            return result;
+        };
+        auto valid = [&](const ofxHap::TimeRangeSet& set, const Bits& expected) {
+            Bits got;
+            int64_t previous = -2;
+            for (const auto& range : set)
+            {
+                // Sorted, positive, and neither overlapping nor touching
+                if (range.length <= 0 || range.start <= previous + 1)
+                {
+                    return false;
+                }
+                previous = range.latest();
+                got |= bits(range);
+            }
+            return got == expected;
+        };
+        for (int run = 0; run < 2000; run++)
+        {
+            ofxHap::TimeRangeSet set;
+            Bits expected;
+            for (int step = 0; step < 12; step++)
+            {
+                ofxHap::TimeRange range = randomRange();
+                switch (operation(random))
+                {
+                    case 0:
+                    case 1:
+                        set.add(range);
+                        expected |= bits(range);
+                        break;
+                    case 2:
+                        set.remove(range);
+                        expected &= ~bits(range);
+                        break;
+                    default:
+                    {
+                        ofxHap::TimeRangeSet other;
+                        Bits otherBits;
+                        for (int i = 0; i < 3; i++)
+                        {
+                            ofxHap::TimeRange o = randomRange();
+                            other.add(o);
+                            otherBits |= bits(o);
+                        }
+                        set = set.intersection(other);
+                        expected &= otherBits;
+                        break;
+                    }
+                }
+                if (!valid(set, expected))
+                {
+                    std::fprintf(stderr, "%s:%d: random run %d diverged at step %d\n", __FILE__, __LINE__, run, step);
+                    print("got", set);
+                    ofxHapTests::fail();
+                    return;
+                }
+                if (set.size())
+                {
+                    CHECK(set.earliest() == set.begin()->start);
+                    CHECK(expected.test(set.latest()) && (set.latest() == kSpan - 1 || !expected.test(set.latest() + 1)));
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    testRange();
+    testAdd();
+    testRemove();
+    testIntersection();
+    testSequence();
+    testStorage();
+    testRandom();
+    return ofxHapTests::finish();
+}
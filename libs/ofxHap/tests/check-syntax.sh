@@ -0,0 +1,32 @@
+#!/bin/sh
+# Checks that every source in the addon compiles, without linking, against an
+# openFrameworks checkout. Run from anywhere:
+#
+#   libs/ofxHap/tests/check-syntax.sh /path/to/openFrameworks
+#
+# Extra compiler flags, such as include paths for openFrameworks' own
+# dependencies, can be given in CXXFLAGS. The library's tests are built with
+# CMakeLists.txt in this directory.
+
+if [ $# -ne 1 ] || [ ! -d "$1/libs/openFrameworks" ]; then
+    echo "usage: $0 OF_ROOT" >&2
+    exit 2
+fi
+OF_ROOT=$1
+ADDON=$(cd "$(dirname "$0")/../../.." && pwd)
+CXX=${CXX:-c++}
+
+INCLUDES="-I$ADDON/src -I$ADDON/libs/ofxHap/include -I$ADDON/libs/ffmpeg/include -I$ADDON/libs/hap/src -I$ADDON/libs/snappy/include"
+for dir in $(find "$OF_ROOT/libs/openFrameworks" -type d) "$OF_ROOT"/libs/*/include; do
+    INCLUDES="$INCLUDES -I$dir"
+done
+
+result=0
+for source in "$ADDON"/libs/ofxHap/src/*.cpp "$ADDON"/src/*.cpp; do
+    if ! $CXX -std=c++14 -fsyntax-only -Wall $INCLUDES $CXXFLAGS "$source"; then
+        echo "failed: $source" >&2
+        result=1
+    fi
+done
+[ $result -eq 0 ] && echo "all sources compiled"
+exit $result
@@ -32,10 +32,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
  */
 #include "ofxHapPlayer.h"
+#include "ofxHapPlayerGroup.h"
 #include <ofxHap/Common.h>
 #include <ofxHap/AudioThread.h>
 #include <ofxHap/RingBuffer.h>
 #include <ofxHap/MovieTime.h>
+#include <ofxHap/FileIdentity.h>
+#include <ofxHap/StorageDevice.h>
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/time.h>
@@ -50,9 +53,29 @@ extern "C" {
 #include <dispatch/dispatch.h>
 #endif
 
-// This amount will be bufferred before and after the playhead
+// This amount will be bufferred before and after the playhead, at least
 #define kofxHapPlayerBufferUSec INT64_C(250000)
+// By default the read-ahead window may grow to this
+#define kofxHapPlayerReadAheadUSec INT64_C(1000000)
+// The OS will be asked to start reading this far ahead of the playhead
+#define kofxHapPlayerPrefetchUSec INT64_C(2000000)
+// When looping, this much of the start of the loop is kept ready by default
+#define kofxHapPlayerLoopPrerollUSec INT64_C(250000)
+// Loop regions this long or shorter are kept entirely in memory
+#define kofxHapPlayerRegionPinUSec INT64_C(4000000)
+// This much of the start of each cue is kept ready
+#define kofxHapPlayerCueUSec INT64_C(250000)
+// By default cues may use this many bytes
+#define kofxHapPlayerCueBudget INT64_C(268435456)
+// By default decoded frame cache files may use this many bytes in their directory
+#define kofxHapPlayerFrameCacheLimit INT64_C(34359738368)
+// Playing backwards, reads are made in blocks of at least this length
+#define kofxHapPlayerReverseBlockUSec INT64_C(1000000)
 #define kofxHapPlayerUSecPerSec 1000000L
+// Before a scheduled start, this much of the movie is kept ready
+#define kofxHapPlayerPrerollUSec INT64_C(250000)
+// Assumed until we have measured how often we are updated
+#define kofxHapPlayerUpdateUSec INT64_C(16667)
 
 namespace ofxHapPY {
     static const string vertexShader = "void main(void)\
@@ -124,6 +147,33 @@ namespace ofxHapPY {
 #endif
     }
 
+    /*
+     The size of a decoded DXT texture
+     */
+    static size_t textureLength(int width, int height, unsigned int textureFormat)
+    {
+        size_t length = roundUpToMultipleOf4(width) * roundUpToMultipleOf4(height);
+        if (textureFormat == HapTextureFormat_RGB_DXT1)
+        {
+            length /= 2;
+        }
+        return length;
+    }
+
+    static unsigned int streamTextureFormat(uint32_t stream)
+    {
+        switch (stream) {
+            case MKTAG('H', 'a', 'p', '1'):
+                return HapTextureFormat_RGB_DXT1;
+            case MKTAG('H', 'a', 'p', '5'):
+                return HapTextureFormat_RGBA_DXT5;
+            case MKTAG('H', 'a', 'p', 'Y'):
+                return HapTextureFormat_YCoCg_DXT5;
+            default:
+                return 0;
+        }
+    }
+
     static bool frameMatchesStream(unsigned int frame, uint32_t stream)
     {
         switch (stream) {
@@ -143,6 +193,35 @@ namespace ofxHapPY {
         }
         return false;
     }
+
+    static bool sameRanges(const ofxHap::TimeRangeSet& a, const ofxHap::TimeRangeSet& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const ofxHap::TimeRange& x, const ofxHap::TimeRange& y) {
+            return x.start == y.start && x.length == y.length;
+        });
+    }
+
+    /*
+     Extend ranges played backwards to start on a block boundary, so each block
+     is read in one go from a single seek rather than piecemeal as the playhead moves
+     */
+    static ofxHap::TimeRangeSequence alignToBlocks(const ofxHap::TimeRangeSequence& sequence, int64_t block)
+    {
+        ofxHap::TimeRangeSequence aligned;
+        for (const auto& range : sequence)
+        {
+            if (range.length < 0)
+            {
+                int64_t start = std::max(INT64_C(0), (range.earliest() / block) * block);
+                aligned.add(ofxHap::TimeRange(start, range.latest() - start + 1));
+            }
+            else
+            {
+                aligned.add(range);
+            }
+        }
+        return aligned;
+    }
 }
 
 // TODO:
@@ -151,10 +230,22 @@ namespace ofxHapPY {
 // 3. Pause in palindrome(low priority)
 
 ofxHapPlayer::ofxHapPlayer() :
-    _loaded(false), _videoStream(nullptr), _audioStreamIndex(-1), _frameTime(av_gettime_relative()), _playing(false),
+    _loaded(false), _videoStream(nullptr), _audioStreamIndex(-1), _loopFrame(*this), _frameTime(av_gettime_relative()), _playing(false),
     _wantsUpload(false),
-    _demuxer(), _buffer(nullptr), _audioThread(nullptr), _audioOut(), _volume(1.0), _timeout(30000),
-    _positionOnLoad(0.0)
+    _videoPackets(std::make_shared<ofxHap::LockingPacketCache>()), _demuxer(), _buffer(nullptr), _audioThread(nullptr), _audioOut(), _volume(1.0), _timeout(30000),
+    _positionOnLoad(0.0), _frameOnLoad(-1), _preloadBudget(0), _frameCacheLimit(kofxHapPlayerFrameCacheLimit), _loadTime(0), _firstFrameTime(AV_NOPTS_VALUE),
+    _readAhead(kofxHapPlayerBufferUSec, kofxHapPlayerReadAheadUSec), _cacheBehind(kofxHapPlayerBufferUSec, kofxHapPlayerBufferUSec),
+    _decodeTime(0), _decodedMedia(0), _stalled(false), _lastAdapt(0), _reverseBlock(0),
+    _lastUpdate(AV_NOPTS_VALUE), _updateInterval(kofxHapPlayerUpdateUSec),
+    _loopPreroll(kofxHapPlayerLoopPrerollUSec), _inPoint(0.0), _outPoint(1.0),
+    _cueBudget(kofxHapPlayerCueBudget), _cueTriggered(AV_NOPTS_VALUE), _cueLatency(AV_NOPTS_VALUE), _cueJumped(false),
+    _memory(ofxHap::MemoryBudget::shared()), _memoryScale(1.0),
+    _separateAudio(false), _audioSeparated(false), _shareSource(false), _audioReceiver(*this),
+    _concurrentReads(0), _readerLimit(1), _videoReceiver(*this),
+    _group(nullptr), _pending(Pending::None), _pendingPacket(nullptr), _pendingPosition(AV_NOPTS_VALUE),
+    _startAt(AV_NOPTS_VALUE), _prerolled(false),
+    _presentationTiming(false), _presentTime(_frameTime), _suppliedTime(AV_NOPTS_VALUE), _suppliedInterval(0),
+    _refreshInterval(kofxHapPlayerUpdateUSec), _shownPTS(AV_NOPTS_VALUE), _shownSince(0), _judderSquares(0.0), _judderCount(0)
 {
     _clock.setPausedAt(true, 0);
     ofAddListener(ofEvents().update, this, &ofxHapPlayer::update);
@@ -162,6 +253,10 @@ ofxHapPlayer::ofxHapPlayer() :
 
 ofxHapPlayer::~ofxHapPlayer()
 {
+    if (_group)
+    {
+        _group->remove(*this);
+    }
     /*
     Close any loaded movie
     */
@@ -190,8 +285,56 @@ bool ofxHapPlayer::load(string name)
     }
 
     _positionOnLoad = 0.0;
+    _frameOnLoad = -1;
+
+    _loadTime = av_gettime_relative();
+    _firstFrameTime = AV_NOPTS_VALUE;
+
+    _frameCachePath.clear();
+    _metadataPath.clear();
+    _readerPath = name;
+    ofxHap::FileIdentity identity(name);
+    if (identity.isValid())
+    {
+        if (!_frameCacheDirectory.empty())
+        {
+            _frameCachePath = ofFilePath::join(_frameCacheDirectory, identity.getKey() + ".hapframes");
+        }
+        if (!_metadataDirectory.empty())
+        {
+            _metadataPath = ofFilePath::join(_metadataDirectory, identity.getKey() + ".hapmeta");
+        }
+    }
+
+    _readerLimit = _concurrentReads > 0 ? _concurrentReads : ofxHap::StorageDevice(name).getConcurrentReads();
 
-    _demuxer = std::make_shared<ofxHap::Demuxer>(name, *this);
+    // A preloaded movie is read once, into memory, by a single demuxer
+    bool preloads = _preloadBudget > 0 && identity.isValid() && identity.getSize() <= _preloadBudget;
+    // A shared source only reads video, so we read our own audio
+    bool shares = _shareSource && identity.isValid() && !preloads;
+    _audioSeparated = (_separateAudio || shares) && !preloads;
+    if (shares)
+    {
+        std::shared_ptr<ofxHap::SharedSource> source = ofxHap::SharedSource::get(name, identity, _metadataPath);
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _source = source;
+            _demuxer = source->getDemuxer();
+            _videoPackets = source->getPackets();
+            _audioDemuxer = std::make_shared<ofxHap::Demuxer>(name, _audioReceiver, 0, _metadataPath, ofxHap::Demuxer::Streams::Audio);
+        }
+        // The source tells us about the movie, at once if it has already found it
+        source->subscribe(*this);
+    }
+    else if (_audioSeparated)
+    {
+        _demuxer = std::make_shared<ofxHap::Demuxer>(name, *this, _preloadBudget, _metadataPath, ofxHap::Demuxer::Streams::Video);
+        _audioDemuxer = std::make_shared<ofxHap::Demuxer>(name, _audioReceiver, 0, _metadataPath, ofxHap::Demuxer::Streams::Audio);
+    }
+    else
+    {
+        _demuxer = std::make_shared<ofxHap::Demuxer>(name, *this, _preloadBudget, _metadataPath);
+    }
 
     /*
     Apply our current state to the movie
@@ -205,6 +348,7 @@ void ofxHapPlayer::foundMovie(int64_t duration)
 {
     std::lock_guard<std::mutex> guard(_lock);
     _clock.period = duration;
+    setRegionLoaded();
 }
 
 void ofxHapPlayer::foundStream(AVStream *stream)
@@ -222,6 +366,29 @@ void ofxHapPlayer::foundStream(AVStream *stream)
     if (type == AVMEDIA_TYPE_VIDEO && codecID == AV_CODEC_ID_HAP)
     {
         _videoStream = stream;
+        _frameIndex.build(stream);
+        if (!_frameCachePath.empty())
+        {
+#if OFX_HAP_HAS_CODECPAR
+            uint32_t tag = params->codec_tag;
+#else
+            uint32_t tag = codec->codec_tag;
+#endif
+            size_t length = getFrameLength();
+            int64_t frames = stream->nb_frames;
+            if (frames <= 0 && stream->avg_frame_rate.num > 0 && stream->duration != AV_NOPTS_VALUE)
+            {
+                frames = av_rescale_q(stream->duration, stream->time_base, av_inv_q(stream->avg_frame_rate)) + 1;
+            }
+            if (ofxHapPY::streamTextureFormat(tag) != 0)
+            {
+                _frameCache = ofxHap::MappedFrameCache::open(_frameCachePath, length, frames, tag, _frameCacheLimit);
+            }
+            if (!_frameCache)
+            {
+                ofLogWarning("ofxHapPlayer", "Decoded frames for this movie can't be cached.");
+            }
+        }
     }
     else if (type == AVMEDIA_TYPE_AUDIO)
     {
@@ -233,11 +400,11 @@ void ofxHapPlayer::foundStream(AVStream *stream)
         int channels = params->channels;
 #endif
         int sampleRate = params->sample_rate;
-        ofxHap::AudioParameters parameters(params, kofxHapPlayerBufferUSec, stream->start_time, stream->duration);
+        ofxHap::AudioParameters parameters(params, static_cast<int>(std::max(getReadAheadWindow(), getCacheBehindWindow())), stream->start_time, stream->duration);
 #else
         int channels = codec->channels;
         int sampleRate = codec->sample_rate;
-        ofxHap::AudioParameters parameters(codec, kofxHapPlayerBufferUSec, stream->start_time, stream->duration);
+        ofxHap::AudioParameters parameters(codec, static_cast<int>(std::max(getReadAheadWindow(), getCacheBehindWindow())), stream->start_time, stream->duration);
 #endif
         sampleRate = _audioOut.getBestRate(sampleRate);
         _audioStreamIndex = stream->index;
@@ -247,7 +414,9 @@ void ofxHapPlayer::foundStream(AVStream *stream)
 
         _audioThread = std::make_shared<ofxHap::AudioThread>(parameters, sampleRate, _buffer, *this);
         _audioThread->setVolume(_volume);
-        _audioThread->sync(_clock, false);
+        syncAudio(false);
+        updateAudioCache();
+        _pinned.clear();
     }
 }
 
@@ -255,7 +424,14 @@ void ofxHapPlayer::foundAllStreams()
 {
     std::lock_guard<std::mutex> guard(_lock);
     _loaded = true;
-    setPositionLoaded(_positionOnLoad);
+    if (_frameOnLoad >= 0)
+    {
+        setFrameLoaded(_frameOnLoad);
+    }
+    else
+    {
+        setPositionLoaded(_positionOnLoad);
+    }
 }
 
 void ofxHapPlayer::readPacket(AVPacket *packet)
@@ -263,7 +439,7 @@ void ofxHapPlayer::readPacket(AVPacket *packet)
     // No need to lock
     if (_videoStream && packet->stream_index == _videoStream->index)
     {
-        _videoPackets.store(packet);
+        _videoPackets->store(packet);
     }
     else if (_audioThread && packet->stream_index == _audioStreamIndex)
     {
@@ -271,11 +447,38 @@ void ofxHapPlayer::readPacket(AVPacket *packet)
     }
 }
 
+void ofxHapPlayer::readPackets(const std::vector<AVPacket *>& packets)
+{
+    // No need to lock
+    std::vector<AVPacket *> video;
+    std::vector<AVPacket *> audio;
+    for (auto packet : packets)
+    {
+        if (_videoStream && packet->stream_index == _videoStream->index)
+        {
+            video.push_back(packet);
+        }
+        else if (_audioThread && packet->stream_index == _audioStreamIndex)
+        {
+            audio.push_back(packet);
+        }
+    }
+    if (video.size() > 0)
+    {
+        _videoPackets->store(video);
+    }
+    if (audio.size() > 0)
+    {
+        _audioThread->send(audio);
+    }
+}
+
 void ofxHapPlayer::discontinuity()
 {
     // No need to lock
-    _videoPackets.cache();
-    if (_audioThread)
+    _videoPackets->cache();
+    // If audio is read separately, its own demuxer tells it about discontinuities
+    if (_audioThread && !_audioSeparated)
     {
         _audioThread->flush();
     }
@@ -284,7 +487,7 @@ void ofxHapPlayer::discontinuity()
 void ofxHapPlayer::endMovie()
 {
     // No need to lock
-    if (_audioThread)
+    if (_audioThread && !_audioSeparated)
     {
         // signal end of stream
         _audioThread->endOfStream();
@@ -306,12 +509,48 @@ void ofxHapPlayer::error(int averror)
 
 void ofxHapPlayer::close()
 {
+    // A shared source calls us with its lock held, so leave it without holding ours,
+    // and keep it until we are done with its demuxer
+    std::shared_ptr<ofxHap::SharedSource> source;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        source.swap(_source);
+        _loaded = false;
+    }
+    if (source)
+    {
+        source->unsubscribe(*this);
+    }
     std::lock_guard<std::mutex> guard(_lock);
+    // Frames being decoded ahead use the demuxer's stream, so finish with them first
+    _loopFrame.clear();
+    for (auto& cue : _cues)
+    {
+        cue.frame->clear();
+    }
     _demuxer.reset();
+    _audioDemuxer.reset();
+    _readers.clear();
     _audioThread.reset();
     _audioOut.close();
     _buffer.reset();
-    _videoPackets.clear();
+    if (source)
+    {
+        _videoPackets = std::make_shared<ofxHap::LockingPacketCache>();
+    }
+    else
+    {
+        _videoPackets->clear();
+    }
+    _frameCache.reset();
+    _active.clear();
+    _audioActive.clear();
+    _prefetched.clear();
+    _frameIndex.clear();
+    _lastReadStatistics = ofxHap::Demuxer::ReadStatistics();
+    _lastAudioReadStatistics = ofxHap::Demuxer::ReadStatistics();
+    _decodeTime = _decodedMedia = 0;
+    _stalled = false;
     _clock.period = 0;
     _clock.setPausedAt(true, 0);
     _wantsUpload = false;
@@ -320,29 +559,228 @@ void ofxHapPlayer::close()
     _shader.unload();
     _texture.clear();
     _decodedFrame.clear();
+    _pendingFrame.clear();
+    ofxHap::PacketFree(_pendingPacket);
+    _pendingPacket = nullptr;
+    _pending = Pending::None;
+    _cueTriggered = AV_NOPTS_VALUE;
+    _startAt = AV_NOPTS_VALUE;
+    _prerolled = false;
+    _shownPTS = AV_NOPTS_VALUE;
     _loaded = false;
     _error.clear();
+    updateMemory();
 }
 
-void ofxHapPlayer::read(ofxHap::TimeRangeSequence& sequence)
+void ofxHapPlayer::read(ofxHap::Demuxer& demuxer, ofxHap::TimeRangeSet& active, const ofxHap::TimeRangeSet& requested,
+                        ofxHap::TimeRangeSequence& sequence, bool spread, int64_t join, bool playing)
 {
+    if (sequence.size() == 0)
+    {
+        return;
+    }
     ofxHap::TimeRangeSequence flattened = ofxHap::MovieTime::flatten(sequence);
-    flattened.remove(_active);
+    flattened.remove(active);
+    if (&requested != &active)
+    {
+        flattened.remove(requested);
+    }
 
+    // Request the range we are playing through before any others (eg the start of a loop)
+    const ofxHap::TimeRange& first = *sequence.begin();
+    std::vector<ofxHap::TimeRange> ranges;
     for (const ofxHap::TimeRange& range : flattened)
     {
-        int64_t lastRead = _demuxer->getLastReadTime();
-        if (lastRead != AV_NOPTS_VALUE && range.earliest() > lastRead && range.earliest() - lastRead < kofxHapPlayerUSecPerSec / 4)
+        if (range.intersects(first))
+        {
+            ranges.insert(ranges.begin(), range);
+        }
+        else
+        {
+            ranges.push_back(range);
+        }
+    }
+
+    for (const ofxHap::TimeRange& range : ranges)
+    {
+        // Ranges after the first may go to another reader, to be read at the same time
+        ofxHap::Demuxer *reader = nullptr;
+        if (spread && &range != &ranges.front())
+        {
+            reader = getSpareReader();
+        }
+        if (!reader)
+        {
+            reader = &demuxer;
+        }
+        // The demuxer reads the range holding the playhead ahead of work queued by
+        // others sharing it, or by us in earlier updates
+        bool urgent = playing && range.intersects(first);
+        int64_t lastRead = reader->getLastReadTime();
+        if (lastRead != AV_NOPTS_VALUE && range.earliest() > lastRead && range.earliest() - lastRead < join)
         {
-            _demuxer->read(range.latest());
-            _active.add(lastRead + 1, range.latest() - lastRead);
+            reader->read(range.latest(), urgent);
+            active.add(lastRead + 1, range.latest() - lastRead);
         }
         else
         {
-            _demuxer->seekTime(range.earliest());
-            _demuxer->read(range.latest());
-            _active.add(range);
+            reader->seekTime(range.earliest(), urgent);
+            reader->read(range.latest(), urgent);
+            active.add(range);
+        }
+    }
+}
+
+ofxHap::Demuxer *ofxHapPlayer::getSpareReader()
+{
+    // Reading from memory is fast enough with one reader
+    if (_demuxer->isPreloaded())
+    {
+        return nullptr;
+    }
+    for (const auto& reader : _readers)
+    {
+        if (!reader->isActive())
+        {
+            return reader.get();
+        }
+    }
+    // The main demuxer counts towards the limit
+    if (static_cast<int>(_readers.size()) + 1 < _readerLimit)
+    {
+        _readers.push_back(std::make_shared<ofxHap::Demuxer>(_readerPath, _videoReceiver, 0, _metadataPath, ofxHap::Demuxer::Streams::Video));
+        return _readers.back().get();
+    }
+    return nullptr;
+}
+
+ofxHap::TimeRange ofxHapPlayer::getCueRange(const Cue& cue) const
+{
+    int64_t start = static_cast<int64_t>(ofClamp(cue.position, 0.0f, 1.0f) * (_clock.period - 1));
+    return ofxHap::TimeRange(start, std::min(kofxHapPlayerCueUSec, _clock.period - start));
+}
+
+int64_t ofxHapPlayer::getCueCost(const ofxHap::TimeRange& range) const
+{
+    // A decoded frame and the packets for the range
+    int64_t cost = getFrameLength();
+    if (_frameIndex.isValid())
+    {
+        int64_t first = _frameIndex.getFrame(getVideoPosition(range.earliest(), 1));
+        int64_t last = _frameIndex.getFrame(getVideoPosition(range.latest(), 1));
+        if (last + 1 < _frameIndex.size())
+        {
+            cost += std::max(_frameIndex.getPosition(last + 1) - _frameIndex.getPosition(first), INT64_C(0));
+        }
+    }
+    return cost;
+}
+
+size_t ofxHapPlayer::getFrameLength() const
+{
+#if OFX_HAP_HAS_CODECPAR
+    return ofxHapPY::textureLength(_videoStream->codecpar->width, _videoStream->codecpar->height, ofxHapPY::streamTextureFormat(_videoStream->codecpar->codec_tag));
+#else
+    return ofxHapPY::textureLength(_videoStream->codec->width, _videoStream->codec->height, ofxHapPY::streamTextureFormat(_videoStream->codec->codec_tag));
+#endif
+}
+
+ofxHap::TimeRange ofxHapPlayer::getLoopStart() const
+{
+    int64_t in = _clock.getIn();
+    int64_t out = _clock.getOut();
+    // Short loop regions are kept whole
+    if (_clock.mode != ofxHap::Clock::Mode::Once && (in > 0 || out < _clock.period) && out - in <= kofxHapPlayerRegionPinUSec)
+    {
+        return ofxHap::TimeRange(in, out - in);
+    }
+    if (_clock.mode != ofxHap::Clock::Mode::Loop || _loopPreroll == 0 || out == in)
+    {
+        return ofxHap::TimeRange(0, 0);
+    }
+    int64_t length = std::min(_loopPreroll, out - in);
+    if (_clock.getRate() < 0)
+    {
+        return ofxHap::TimeRange(out - length, length);
+    }
+    return ofxHap::TimeRange(in, length);
+}
+
+int64_t ofxHapPlayer::getVideoPosition(int64_t pts, int stride) const
+{
+    if (stride > 1)
+    {
+        return _frameIndex.getTime(getStrideFrame(pts, stride));
+    }
+    return av_rescale_q_rnd(pts, { 1, AV_TIME_BASE }, _videoStream->time_base, AV_ROUND_DOWN);
+}
+
+int ofxHapPlayer::getStride() const
+{
+    if (!_frameIndex.isValid() || _clock.getPaused() || _clock.period == 0)
+    {
+        return 1;
+    }
+    // The movie time which passes between updates, in frames
+    double step = std::fabs(_clock.getRate()) * _updateInterval * _frameIndex.size() / _clock.period;
+    // Powers of two, so the frames shown don't change with small changes in the update rate
+    int stride = 1;
+    while (stride * 2 <= step)
+    {
+        stride *= 2;
+    }
+    return stride;
+}
+
+int64_t ofxHapPlayer::getStrideFrame(int64_t pts, int stride) const
+{
+    int64_t frame = _frameIndex.getFrame(av_rescale_q_rnd(pts, { 1, AV_TIME_BASE }, _videoStream->time_base, AV_ROUND_DOWN));
+    return frame - (frame % stride);
+}
+
+ofxHap::TimeRange ofxHapPlayer::getFrameRange(int64_t frame) const
+{
+    // Round up so a seek to the start of the range finds this frame rather than the one before
+    int64_t pts = _frameIndex.getTime(frame);
+    int64_t start = av_rescale_q_rnd(pts, _videoStream->time_base, { 1, AV_TIME_BASE }, AV_ROUND_UP);
+    int64_t end = av_rescale_q_rnd(pts + _frameIndex.getDuration(frame), _videoStream->time_base, { 1, AV_TIME_BASE }, AV_ROUND_UP);
+    return ofxHap::TimeRange(start, end - start);
+}
+
+ofxHap::TimeRangeSequence ofxHapPlayer::getStrideFrames(const ofxHap::TimeRangeSequence& sequence, int stride) const
+{
+    ofxHap::TimeRangeSequence frames;
+    for (const auto& range : sequence)
+    {
+        int64_t first = getStrideFrame(range.earliest(), stride);
+        int64_t last = getStrideFrame(range.latest(), stride);
+        for (int64_t i = 0; i <= (last - first) / stride; i++)
+        {
+            // In the order they will be shown
+            frames.add(getFrameRange(range.length < 0 ? last - (i * stride) : first + (i * stride)));
+        }
+    }
+    return frames;
+}
+
+void ofxHapPlayer::prefetch()
+{
+    // Hints are sent a window at a time, once the nearer half of the window isn't covered
+    ofxHap::TimeRangeSequence soon = ofxHap::MovieTime::nextRanges(_clock, _presentTime, std::min(_clock.period, kofxHapPlayerPrefetchUSec / 2));
+    soon.remove(_prefetched);
+    if (soon.size() > 0)
+    {
+        // This includes the loop start (or end, in reverse) if we will wrap soon
+        ofxHap::TimeRangeSequence ahead = ofxHap::MovieTime::nextRanges(_clock, _presentTime, std::min(_clock.period, kofxHapPlayerPrefetchUSec));
+        ofxHap::TimeRangeSequence flattened = ofxHap::MovieTime::flatten(ahead);
+        flattened.remove(_prefetched);
+        for (const ofxHap::TimeRange& range : flattened)
+        {
+            _demuxer->prefetch(range);
+            _prefetched.add(range);
         }
+        // Forget anything behind us, so we hint again next time round a loop
+        _prefetched = _prefetched.intersection(ahead);
     }
 }
 
@@ -356,6 +794,12 @@ void ofxHapPlayer::update(ofEventArgs & args)
 {
     std::lock_guard<std::mutex> guard(_lock);
 
+    // A group updates its players itself
+    if (_group)
+    {
+        return;
+    }
+
     // Calculate our current position for video and audio (if present)
     updatePTS();
 
@@ -364,38 +808,178 @@ void ofxHapPlayer::update(ofEventArgs & args)
         return;
     }
 
-    int64_t pts = _clock.getTime();
+    updateLoaded();
+}
+
+void ofxHapPlayer::updateLoaded()
+{
+    // The position when the frame we choose will be seen
+    int64_t pts = _clock.getTimeAt(_presentTime);
+
+    // Measure how often we are updated, which is how often a new frame can be shown
+    if (_lastUpdate != AV_NOPTS_VALUE)
+    {
+        _updateInterval += (_frameTime - _lastUpdate - _updateInterval) / 8;
+    }
+    _lastUpdate = _frameTime;
+
+    // At high speeds only every Nth frame can be shown, so only decode those, and if
+    // the packets in between aren't needed for audio, only read those
+    int stride = getStride();
+    bool strideReads = stride > 1 && (_audioSeparated || _audioStreamIndex < 0);
+    int64_t shown = pts;
+    if (stride > 1)
+    {
+        shown = getFrameRange(getStrideFrame(pts, stride)).start;
+    }
+
+    // Shrink our windows if the memory budget asks us to
+    float scale = _memory.getScale();
+    if (scale != _memoryScale)
+    {
+        _memoryScale = scale;
+        updateAudioCache();
+    }
 
     // Sequences ahead of us (to request from the demuxer) and to keep cached
-    ofxHap::TimeRangeSequence future = ofxHap::MovieTime::nextRanges(_clock, _frameTime, std::min(_clock.period, kofxHapPlayerBufferUSec));
-    ofxHap::TimeRangeSequence cache = ofxHap::MovieTime::nextRanges(_clock, _frameTime - kofxHapPlayerBufferUSec, std::min(_clock.period, kofxHapPlayerBufferUSec * INT64_C(2)));
+    int64_t ahead = getReadAheadWindow();
+    int64_t behind = getCacheBehindWindow();
+    // Playing backwards, request a whole block behind the playhead at a time, and the
+    // next block while the current one is played through, keeping both cached
+    int64_t block = 0;
+    if (!strideReads && !_clock.getPaused() && _clock.getDirectionAt(_presentTime) == ofxHap::Clock::Direction::Backwards)
+    {
+        block = std::max(ahead, kofxHapPlayerReverseBlockUSec);
+    }
+    if (block != _reverseBlock)
+    {
+        _reverseBlock = block;
+        updateAudioCache();
+    }
+    ofxHap::TimeRangeSequence future = ofxHap::MovieTime::nextRanges(_clock, _presentTime, std::min(_clock.period, ahead + block));
+    ofxHap::TimeRangeSequence cache = ofxHap::MovieTime::nextRanges(_clock, _presentTime - behind, std::min(_clock.period, behind + ahead + block));
+    ofxHap::TimeRangeSet keep(cache);
+    // Keep the start of the loop, so wrapping around doesn't wait on a seek
+    ofxHap::TimeRange loopStart = getLoopStart();
+    ofxHap::TimeRangeSequence preroll;
+    ofxHap::TimeRangeSequence pinned = updatePinned(loopStart, preroll);
+    for (const auto& range : pinned)
+    {
+        keep.add(range);
+    }
+    if (block)
+    {
+        future = ofxHapPY::alignToBlocks(future, block);
+        for (const auto& range : future)
+        {
+            keep.add(range);
+        }
+    }
     // Rescale the cache for video
     ofxHap::TimeRangeSet vcache;
-    for (auto& range : cache)
+    for (auto& range : keep)
     {
         // Careful rounding: don't discard needed samples - important at low rates when timebase is framerate
         ofxHap::TimeRange vrange(av_rescale_q_rnd(range.start, { 1, AV_TIME_BASE }, _videoStream->time_base, AV_ROUND_DOWN),
                                  av_rescale_q_rnd(range.length, { 1, AV_TIME_BASE }, _videoStream->time_base, AV_ROUND_UP));
         vcache.add(vrange);
     }
-    // Release any packets we no longer need
-    _videoPackets.limit(vcache);
+    // Release any packets we no longer need. A shared source keeps what any of its
+    // players need, and tracks what they have requested between them
+    ofxHap::TimeRangeSet& active = _active;
+    ofxHap::TimeRangeSet shared = _source ? _source->getActive() : ofxHap::TimeRangeSet();
+    const ofxHap::TimeRangeSet& requested = _source ? shared : active;
+    ofxHap::TimeRangeSet kept = keep;
+    if (_source)
+    {
+        kept = _source->limit(*this, keep, vcache);
+    }
+    else
+    {
+        _videoPackets->limit(vcache);
+    }
+
+    // If the playhead has left the ranges requested (eg when scrubbing), the
+    // demuxer's queued work is for somewhere we no longer need. A cue is kept read, so
+    // also check if we jumped to one. A shared demuxer is only cancelled if no other
+    // player is waiting for what it has queued, and we read after their requests
+    bool moved = false;
+    if (requested.size() > 0 && (!requested.includes(shown) || _cueJumped))
+    {
+        if (_source)
+        {
+            _source->cancel(*this);
+            shared = _source->getActive();
+        }
+        else
+        {
+            _demuxer->cancel();
+        }
+        for (const auto& reader : _readers)
+        {
+            reader->cancel();
+        }
+        active.clear();
+        moved = true;
+    }
+    if (_audioDemuxer && _audioActive.size() > 0 && (!_audioActive.includes(pts) || _cueJumped))
+    {
+        _audioDemuxer->cancel();
+        _audioActive.clear();
+    }
+    _cueJumped = false;
+
+    active = active.intersection(kept);
+    _audioActive = _audioActive.intersection(keep);
 
-    _active = _active.intersection(cache);
+    // Extra readers only read video, so can only be used if the main demuxer isn't reading audio
+    if (strideReads)
+    {
+        // Each frame is read with its own seek
+        ofxHap::TimeRangeSequence frames = getStrideFrames(future, stride);
+        read(*_demuxer, active, requested, frames, true, 0, true);
+    }
+    else
+    {
+        read(*_demuxer, active, requested, future, _audioSeparated || _audioStreamIndex < 0, kofxHapPlayerUSecPerSec / 4, true);
+    }
+    if (_audioDemuxer)
+    {
+        read(*_audioDemuxer, _audioActive, _audioActive, future, false, kofxHapPlayerUSecPerSec / 4, true);
+    }
+    // This only reads anything the first time, or if we have moved away and they have been cancelled
+    read(*_demuxer, active, requested, pinned, false, kofxHapPlayerUSecPerSec / 4, false);
+    if (_audioDemuxer)
+    {
+        read(*_audioDemuxer, _audioActive, _audioActive, pinned, false, kofxHapPlayerUSecPerSec / 4, false);
+    }
+    if (_source)
+    {
+        _source->setActive(*this, active);
+    }
 
-    read(future);
+    prefetch();
 
     int64_t vidPosition;
-    if (_clock.getDone())
+    bool waited = false;
+    // Playing once, we may be done by the time the frame is seen
+    if (_clock.getDone() || (_clock.mode == ofxHap::Clock::Mode::Once && pts == _clock.getOut()))
     {
-        // Don't use pts from the clock which is duration - we want the last frame time
-        vidPosition = _videoStream->duration - 1;
+        // Don't use pts from the clock which is the out point - we want the last frame time
+        if (_clock.getOut() < _clock.period)
+        {
+            vidPosition = getVideoPosition(_clock.getOut() - 1, stride);
+        }
+        else
+        {
+            vidPosition = _videoStream->duration - 1;
+        }
         // Stop if we have got to the end of the movie and aren't looping
         _playing = false;
     }
     else
     {
-        vidPosition = av_rescale_q_rnd(pts, { 1, AV_TIME_BASE }, _videoStream->time_base, AV_ROUND_DOWN);
+        vidPosition = getVideoPosition(pts, stride);
     }
     // No frame if the movie position outlies the video track length
     if (vidPosition > _videoStream->duration || (_videoStream->start_time != AV_NOPTS_VALUE && vidPosition < _videoStream->start_time))
@@ -404,76 +988,453 @@ void ofxHapPlayer::update(ofEventArgs & args)
     }
     else
     {
-        // Retreive the video frame if necessary
-        bool inBuffer = (_decodedFrame.isValid() && _decodedFrame.pts <= vidPosition && _decodedFrame.pts + _decodedFrame.duration > vidPosition) ? true : false;
-        if (!inBuffer)
+        // Retreive the video frame if necessary. In a group, the frame waits in
+        // _pendingFrame until every player in the group has one
+        bool inBuffer = _decodedFrame.includes(vidPosition);
+        if (!inBuffer && _group)
         {
-            AVPacket *packet = av_packet_alloc();
-            packet->data = NULL;
-            packet->size = 0;
-            // Fetch a stored packet, blocking until our timeout only if necessary
-            bool found = _videoPackets.fetch(vidPosition, packet);
-            if (!found && _demuxer->isActive())
-            {
-                found = _videoPackets.fetch(vidPosition, packet, _timeout);
-            }
-            if (found)
-            {
-                unsigned int textureCount;
-                unsigned int hapResult = HapGetFrameTextureCount(packet->data, packet->size, &textureCount);
-                if (hapResult == HapResult_No_Error && textureCount == 1) // TODO: Hap Q+A
-                {
-                    unsigned int textureFormat;
-                    hapResult = HapGetFrameTextureFormat(packet->data, packet->size, 0, &textureFormat);
-#if OFX_HAP_HAS_CODECPAR
-                    if (hapResult == HapResult_No_Error && !ofxHapPY::frameMatchesStream(textureFormat, _videoStream->codecpar->codec_tag))
-#else
-                    if (hapResult == HapResult_No_Error && !ofxHapPY::frameMatchesStream(textureFormat, _videoStream->codec->codec_tag))
-#endif
-                    {
-                        hapResult = HapResult_Bad_Frame;
-                    }
-                    if (hapResult == HapResult_No_Error)
-                    {
-#if OFX_HAP_HAS_CODECPAR
-                        size_t length = ofxHapPY::roundUpToMultipleOf4(_videoStream->codecpar->width) * ofxHapPY::roundUpToMultipleOf4(_videoStream->codecpar->height);
-#else
-                        size_t length = ofxHapPY::roundUpToMultipleOf4(_videoStream->codec->width) * ofxHapPY::roundUpToMultipleOf4(_videoStream->codec->height);
-#endif
-                        if (textureFormat == HapTextureFormat_RGB_DXT1)
-                        {
-                            length /= 2;
-                        }
-                        if (_decodedFrame.buffer.size() != length)
-                        {
-                            _decodedFrame.buffer.resize(length);
-                        }
-                        unsigned long bytesUsed;
-                        hapResult = HapDecode(packet->data,
-                                              packet->size,
-                                              0,
-                                              ofxHapPY::doDecode,
-                                              NULL,
-                                              _decodedFrame.buffer.data(),
-                                              static_cast<unsigned long>(_decodedFrame.buffer.size()),
-                                              &bytesUsed,
-                                              &textureFormat);
-                    }
-                }
-                if (hapResult == HapResult_No_Error)
-                {
-                    _decodedFrame.pts = packet->pts;
-                    _decodedFrame.duration = packet->duration;
-                    _wantsUpload = true;
-                }
-                else
-                {
-                    _decodedFrame.invalidate();
-                }
-                av_packet_free(&packet);
+            pendFrame(vidPosition, moved);
+        }
+        else if (!inBuffer && loadFrame(vidPosition, moved, waited))
+        {
+            showFrame();
+        }
+        if (!_group)
+        {
+            updatePresentationStatistics(vidPosition, waited);
+        }
+    }
+
+    updatePrerolled(preroll, vidPosition);
+
+    keepFrames(loopStart, future, stride);
+
+    adapt();
+
+    updateMemory();
+}
+
+ofxHap::TimeRangeSequence ofxHapPlayer::updatePinned(const ofxHap::TimeRange& loopStart, ofxHap::TimeRangeSequence& preroll)
+{
+    ofxHap::TimeRangeSequence pinned;
+    if (loopStart.length > 0)
+    {
+        pinned.add(loopStart);
+    }
+    // Before a scheduled start, keep the start read and its audio decoded
+    if (_startAt != AV_NOPTS_VALUE)
+    {
+        preroll = ofxHap::MovieTime::nextRanges(getScheduledClock(), _startAt, std::min(_clock.period, kofxHapPlayerPrerollUSec));
+        for (const auto& range : preroll)
+        {
+            pinned.add(range);
+        }
+    }
+    // Keep the start of cues, in the order they were added, within our budget
+    int64_t used = 0;
+    for (auto& cue : _cues)
+    {
+        ofxHap::TimeRange range = getCueRange(cue);
+        int64_t cost = getCueCost(range);
+        cue.resident = used + cost <= static_cast<int64_t>(_cueBudget * _memoryScale);
+        if (cue.resident)
+        {
+            used += cost;
+            pinned.add(range);
+        }
+        else
+        {
+            cue.frame->clear();
+        }
+    }
+    ofxHap::TimeRangeSet pinnedSet(pinned);
+    if (_audioThread && !ofxHapPY::sameRanges(pinnedSet, _pinned))
+    {
+        _audioThread->setPinned(pinnedSet);
+        _pinned = pinnedSet;
+    }
+    return pinned;
+}
+
+bool ofxHapPlayer::findFrame(int64_t position, DecodedFrame& frame)
+{
+    if (_loopFrame.fetch(position, frame))
+    {
+        // We have wrapped around a loop
+        return true;
+    }
+    if (_source)
+    {
+        // Another player of this movie may have decoded the frame
+        ofxHap::SharedSource::Frame shared;
+        if (_source->fetchFrame(position, shared))
+        {
+            frame.share(shared);
+            return true;
+        }
+    }
+    if (_frameCache)
+    {
+        // Use a frame decoded on a previous play if we have one
+        int64_t start;
+        int64_t duration;
+        const char *mapped = _frameCache->fetch(position, start, duration);
+        if (mapped)
+        {
+            frame.shared.reset();
+            frame.mapped = mapped;
+            frame.mappedSize = _frameCache->getFrameSize();
+            frame.pts = start;
+            frame.duration = duration;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ofxHapPlayer::loadFrame(int64_t position, bool moved, bool& waited)
+{
+    if (findFrame(position, _decodedFrame))
+    {
+        return true;
+    }
+    AVPacket *packet = ofxHap::PacketAlloc();
+    // Fetch a stored packet, blocking until our timeout only if necessary
+    bool found = _videoPackets->fetch(position, packet);
+    if (!found && _demuxer->isActive())
+    {
+        // Waiting during steady playback means we aren't reading far enough ahead
+        if (!_clock.getPaused() && !moved)
+        {
+            _stalled = true;
+        }
+        waited = true;
+        found = _videoPackets->fetch(position, packet, _timeout);
+    }
+    bool ready = found && decodeFrame(packet, _decodedFrame);
+    ofxHap::PacketFree(packet);
+    return ready;
+}
+
+void ofxHapPlayer::pendFrame(int64_t position, bool moved)
+{
+    if (findFrame(position, _pendingFrame))
+    {
+        _pending = Pending::Ready;
+        return;
+    }
+    AVPacket *packet = ofxHap::PacketAlloc();
+    if (_videoPackets->fetch(position, packet))
+    {
+        // The group decodes its players' frames together
+        ofxHap::PacketFree(_pendingPacket);
+        _pendingPacket = packet;
+        _pending = Pending::Decode;
+        return;
+    }
+    ofxHap::PacketFree(packet);
+    if (_demuxer->isActive())
+    {
+        // Still being read. The group waits for every player's missing packet at
+        // once, and holds back its other players' frames if it doesn't arrive
+        if (!_clock.getPaused() && !moved)
+        {
+            _stalled = true;
+        }
+        _pendingPosition = position;
+        _pending = Pending::Missing;
+    }
+}
+
+void ofxHapPlayer::updatePrerolled(const ofxHap::TimeRangeSequence& preroll, int64_t position)
+{
+    // Pre-roll is complete once the first frame is decoded, every packet of the start
+    // has been read and the audio thread has the start of the audio ready to play
+    if (_startAt == AV_NOPTS_VALUE || preroll.size() == 0)
+    {
+        return;
+    }
+    _prerolled = _decodedFrame.includes(position);
+    int64_t length = 0;
+    for (const auto& range : preroll)
+    {
+        length += std::abs(range.length);
+    }
+    if (_prerolled && _audioThread)
+    {
+        // Within a millisecond, as audio is measured in whole samples
+        _prerolled = _audioThread->getBufferedAtStart() >= length - 1000;
+    }
+    AVPacket *packet = ofxHap::PacketAlloc();
+    for (auto range = preroll.begin(); _prerolled && range != preroll.end(); ++range)
+    {
+        // Step through the range a packet at a time
+        int64_t next = getVideoPosition(range->earliest(), 1);
+        int64_t last = getVideoPosition(range->latest(), 1);
+        while (_prerolled && next <= last)
+        {
+            _prerolled = _videoPackets->fetch(next, packet);
+            if (_prerolled)
+            {
+                next = packet->pts + packet->duration;
+                av_packet_unref(packet);
+            }
+        }
+    }
+    ofxHap::PacketFree(packet);
+}
+
+void ofxHapPlayer::keepFrames(const ofxHap::TimeRange& loopStart, const ofxHap::TimeRangeSequence& future, int stride)
+{
+    // Decode the first frame of the loop once we are near the end, so wrapping
+    // around only needs an upload
+    if (loopStart.length > 0 && _clock.mode == ofxHap::Clock::Mode::Loop && future.size() > 1)
+    {
+        int64_t loopPosition = getVideoPosition(_clock.getRate() < 0 ? loopStart.latest() : loopStart.earliest(), stride);
+        keepFrame(_loopFrame, loopPosition);
+    }
+
+    // Decode the first frame of each cue, so jumping to one only needs an upload
+    for (auto& cue : _cues)
+    {
+        if (cue.resident)
+        {
+            keepFrame(*cue.frame, getVideoPosition(getCueRange(cue).start, 1));
+        }
+    }
+}
+
+void ofxHapPlayer::adapt()
+{
+    // Resize our windows once a second from the cost of reading and decoding over that second
+    if (_frameTime - _lastAdapt < kofxHapPlayerUSecPerSec)
+    {
+        return;
+    }
+    auto readLoad = [](const ofxHap::Demuxer::ReadStatistics& now, const ofxHap::Demuxer::ReadStatistics& then) {
+        return now.media > then.media ? (now.time - then.time) / static_cast<double>(now.media - then.media) : 0.0;
+    };
+    // Extra readers share the video with the main demuxer, so their costs are pooled,
+    // while a separate audio demuxer's cost is added to theirs
+    ofxHap::Demuxer::ReadStatistics read = _demuxer->getReadStatistics();
+    for (const auto& reader : _readers)
+    {
+        ofxHap::Demuxer::ReadStatistics extra = reader->getReadStatistics();
+        read.bytes += extra.bytes;
+        read.time += extra.time;
+        read.media += extra.media;
+    }
+    double load = readLoad(read, _lastReadStatistics);
+    if (_audioDemuxer)
+    {
+        ofxHap::Demuxer::ReadStatistics audio = _audioDemuxer->getReadStatistics();
+        load += readLoad(audio, _lastAudioReadStatistics);
+        _lastAudioReadStatistics = audio;
+    }
+    if (_decodedMedia > 0)
+    {
+        load += _decodeTime / static_cast<double>(_decodedMedia);
+    }
+    load *= std::fabs(_clock.getRate());
+    _readAhead.update(load, _stalled);
+    _cacheBehind.update(load, _stalled);
+    updateAudioCache();
+    _lastReadStatistics = read;
+    _decodeTime = _decodedMedia = 0;
+    _stalled = false;
+    _lastAdapt = _frameTime;
+}
+
+void ofxHapPlayer::updateAudioCache()
+{
+    if (_audioThread)
+    {
+        _audioThread->setCache(std::max(getReadAheadWindow(), getCacheBehindWindow()) + _reverseBlock);
+    }
+}
+
+int64_t ofxHapPlayer::getReadAheadWindow() const
+{
+    // Always read far enough ahead to play
+    return std::max(kofxHapPlayerBufferUSec, static_cast<int64_t>(_readAhead.getWindow() * _memoryScale));
+}
+
+int64_t ofxHapPlayer::getCacheBehindWindow() const
+{
+    return static_cast<int64_t>(_cacheBehind.getWindow() * _memoryScale);
+}
+
+void ofxHapPlayer::updateMemory()
+{
+    size_t frames = _decodedFrame.buffer.capacity() + _loopFrame.getBytes() + _pendingFrame.buffer.capacity();
+    for (const auto& cue : _cues)
+    {
+        frames += cue.frame->getBytes();
+    }
+    int64_t packets = _videoPackets->getBytes();
+    if (_source)
+    {
+        // Count our share of what we share
+        size_t count = std::max(size_t(1), _source->getSubscriberCount());
+        packets /= count;
+        frames += _source->getFrameBytes() / count;
+    }
+    // Every tier at once, so the shared budget is only locked once
+    int64_t usage[ofxHap::MemoryBudget::kTierCount];
+    usage[static_cast<int>(ofxHap::MemoryBudget::Tier::Preload)] = _demuxer ? _demuxer->getPreloadedBytes() : 0;
+    usage[static_cast<int>(ofxHap::MemoryBudget::Tier::Packets)] = packets;
+    usage[static_cast<int>(ofxHap::MemoryBudget::Tier::Audio)] = _audioThread ? _audioThread->getCacheBytes() : 0;
+    usage[static_cast<int>(ofxHap::MemoryBudget::Tier::Frames)] = frames;
+    _memory.setUsage(usage);
+}
+
+bool ofxHapPlayer::decodeFrame(AVPacket *packet, DecodedFrame& frame)
+{
+    int64_t start = av_gettime_relative();
+    if (!decode(packet, frame))
+    {
+        frame.invalidate();
+        return false;
+    }
+    _decodeTime += av_gettime_relative() - start;
+    _decodedMedia += av_rescale_q(frame.duration, _videoStream->time_base, { 1, AV_TIME_BASE });
+    if (_frameCache)
+    {
+        _frameCache->store(frame.pts, frame.duration, frame.data());
+    }
+    if (_source)
+    {
+        frame.share(_source->storeFrame(frame.pts, frame.duration, frame.buffer));
+    }
+    return true;
+}
+
+void ofxHapPlayer::keepFrame(KeptFrame& frame, int64_t position)
+{
+    if (frame.wants(position))
+    {
+        AVPacket *packet = ofxHap::PacketAlloc();
+        if (_videoPackets->fetch(position, packet))
+        {
+            frame.decode(packet);
+        }
+        else
+        {
+            ofxHap::PacketFree(packet);
+        }
+    }
+}
+
+void ofxHapPlayer::showFrame()
+{
+    _wantsUpload = true;
+    if (_firstFrameTime == AV_NOPTS_VALUE)
+    {
+        _firstFrameTime = av_gettime_relative() - _loadTime;
+    }
+}
+
+ofxHapPlayer::Pending ofxHapPlayer::fetchPending(int64_t since)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_pending == Pending::Missing)
+    {
+        int64_t remaining = std::max(int64_t(0), since + _timeout.count() - av_gettime_relative());
+        AVPacket *packet = ofxHap::PacketAlloc();
+        if (_videoPackets->fetch(_pendingPosition, packet, std::chrono::microseconds(remaining)))
+        {
+            ofxHap::PacketFree(_pendingPacket);
+            _pendingPacket = packet;
+            packet = nullptr;
+            _pending = Pending::Decode;
+        }
+        ofxHap::PacketFree(packet);
+    }
+    return _pending;
+}
+
+void ofxHapPlayer::decodePending()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_pending == Pending::Decode)
+    {
+        // A frame which fails to decode is shown as no frame, as it is outside a group
+        decodeFrame(_pendingPacket, _pendingFrame);
+        ofxHap::PacketFree(_pendingPacket);
+        _pendingPacket = nullptr;
+        _pending = Pending::Ready;
+    }
+}
+
+void ofxHapPlayer::presentPending(bool present)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_pending == Pending::Ready && present)
+    {
+        if (_pendingFrame.isValid())
+        {
+            // Swap so both buffers are kept for reuse
+            std::swap(_decodedFrame, _pendingFrame);
+            showFrame();
+        }
+        else
+        {
+            _decodedFrame.invalidate();
+        }
+    }
+    ofxHap::PacketFree(_pendingPacket);
+    _pendingPacket = nullptr;
+    _pending = Pending::None;
+}
+
+bool ofxHapPlayer::decode(AVPacket *packet, DecodedFrame& frame)
+{
+    unsigned int textureCount;
+    unsigned int hapResult = HapGetFrameTextureCount(packet->data, packet->size, &textureCount);
+    if (hapResult == HapResult_No_Error && textureCount == 1) // TODO: Hap Q+A
+    {
+        unsigned int textureFormat;
+        hapResult = HapGetFrameTextureFormat(packet->data, packet->size, 0, &textureFormat);
+#if OFX_HAP_HAS_CODECPAR
+        if (hapResult == HapResult_No_Error && !ofxHapPY::frameMatchesStream(textureFormat, _videoStream->codecpar->codec_tag))
+#else
+        if (hapResult == HapResult_No_Error && !ofxHapPY::frameMatchesStream(textureFormat, _videoStream->codec->codec_tag))
+#endif
+        {
+            hapResult = HapResult_Bad_Frame;
+        }
+        if (hapResult == HapResult_No_Error)
+        {
+#if OFX_HAP_HAS_CODECPAR
+            size_t length = ofxHapPY::textureLength(_videoStream->codecpar->width, _videoStream->codecpar->height, textureFormat);
+#else
+            size_t length = ofxHapPY::textureLength(_videoStream->codec->width, _videoStream->codec->height, textureFormat);
+#endif
+            if (frame.buffer.size() != length)
+            {
+                frame.buffer.resize(length);
             }
+            unsigned long bytesUsed;
+            hapResult = HapDecode(packet->data,
+                                  packet->size,
+                                  0,
+                                  ofxHapPY::doDecode,
+                                  NULL,
+                                  frame.buffer.data(),
+                                  static_cast<unsigned long>(frame.buffer.size()),
+                                  &bytesUsed,
+                                  &textureFormat);
         }
     }
+    if (hapResult == HapResult_No_Error)
+    {
+        frame.mapped = nullptr;
+        frame.shared.reset();
+        frame.pts = packet->pts;
+        frame.duration = packet->duration;
+        return true;
+    }
+    return false;
 }
 
 bool ofxHapPlayer::getHapAvailable() const
@@ -566,7 +1527,7 @@ ofTexture* ofxHapPlayer::getTexture()
             glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
         }
         glPixelStorei(GL_UNPACK_CLIENT_STORAGE_APPLE, GL_TRUE);
-        glTextureRangeAPPLE(GL_TEXTURE_2D, _decodedFrame.buffer.size(), _decodedFrame.buffer.data());
+        glTextureRangeAPPLE(GL_TEXTURE_2D, _decodedFrame.size(), _decodedFrame.data());
 #endif
         // As above, some drivers require rounded dimensions here
         glCompressedTexSubImage2D(GL_TEXTURE_2D,
@@ -581,8 +1542,8 @@ ofTexture* ofxHapPlayer::getTexture()
             ofxHapPY::roundUpToMultipleOf4(_videoStream->codec->height),
 #endif
             internalFormat,
-            static_cast<GLsizei>(_decodedFrame.buffer.size()),
-            _decodedFrame.buffer.data());
+            static_cast<GLsizei>(_decodedFrame.size()),
+            _decodedFrame.data());
 
 #if defined(TARGET_OSX)
         if (ofGetGLRenderer()->getGLVersionMajor() < 3)
@@ -596,6 +1557,11 @@ ofTexture* ofxHapPlayer::getTexture()
 #endif
         _texture.unbind();
         _wantsUpload = false;
+        if (_cueTriggered != AV_NOPTS_VALUE)
+        {
+            _cueLatency = av_gettime_relative() - _cueTriggered;
+            _cueTriggered = AV_NOPTS_VALUE;
+        }
     }
     return &_texture;
 }
@@ -657,7 +1623,7 @@ void ofxHapPlayer::play()
     _playing = true;
     if (_clock.getDone())
     {
-        _clock.syncAt(0, _frameTime);
+        _clock.syncAt(_clock.getIn(), _frameTime);
         if (_audioThread)
         {
             _audioThread->sync(_clock, false);
@@ -685,7 +1651,10 @@ void ofxHapPlayer::setPaused(bool pause)
 void ofxHapPlayer::setPaused(bool pause, bool locked)
 {
     assert(locked);
-    if (_clock.getPaused() != pause)
+    // Pausing or playing cancels a scheduled start
+    bool scheduled = _startAt != AV_NOPTS_VALUE;
+    _startAt = AV_NOPTS_VALUE;
+    if (_clock.getPaused() != pause || scheduled)
     {
         if (!pause)
         {
@@ -699,6 +1668,60 @@ void ofxHapPlayer::setPaused(bool pause, bool locked)
     }
 }
 
+void ofxHapPlayer::playAt(int64_t timestamp)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _playing = true;
+    _startAt = timestamp;
+    _prerolled = false;
+    if (_loaded)
+    {
+        // Hold the current frame until the start
+        if (_clock.getDone())
+        {
+            _clock.syncAt(_clock.getIn(), _frameTime);
+        }
+        _clock.setPausedAt(true, _frameTime);
+        syncAudio(false);
+        // The next update starts reading and decoding the start, so the caller,
+        // which may be scheduling many players at once, isn't held up
+    }
+}
+
+bool ofxHapPlayer::isPrerolled() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _prerolled;
+}
+
+int64_t ofxHapPlayer::getTimestamp()
+{
+    return av_gettime_relative();
+}
+
+void ofxHapPlayer::syncAudio(bool soft)
+{
+    if (_audioThread)
+    {
+        if (_startAt != AV_NOPTS_VALUE)
+        {
+            // The audio thread starts itself at the scheduled time
+            _audioThread->syncAt(getScheduledClock(), _startAt);
+        }
+        else
+        {
+            _audioThread->sync(_clock, soft);
+        }
+    }
+}
+
+ofxHap::Clock ofxHapPlayer::getScheduledClock() const
+{
+    ofxHap::Clock scheduled = _clock;
+    scheduled.setPausedAt(false, _startAt);
+    return scheduled;
+}
+
 bool ofxHapPlayer::isFrameNew() const
 {
     return _wantsUpload;
@@ -738,274 +1761,877 @@ float ofxHapPlayer::getHeight() const
     }
 }
 
-bool ofxHapPlayer::isPaused() const
+bool ofxHapPlayer::isPaused() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.getPaused();
+}
+
+bool ofxHapPlayer::isLoaded() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _loaded;
+}
+
+bool ofxHapPlayer::isPlaying() const
+{
+    return _playing;
+}
+
+std::string ofxHapPlayer::getError() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _error;
+}
+
+ofPixels& ofxHapPlayer::getPixels()
+{
+    static ofPixels none;
+    return none;
+}
+
+const ofPixels& ofxHapPlayer::getPixels() const
+{
+    static ofPixels none;
+    return none;
+}
+
+ofPixelFormat ofxHapPlayer::getPixelFormat() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_videoStream)
+    {
+#if OFX_HAP_HAS_CODECPAR
+        switch (_videoStream->codecpar->codec_tag) {
+#else
+        switch (_videoStream->codec->codec_tag) {
+#endif
+            case MKTAG('H', 'a', 'p', '5'):
+                return OF_PIXELS_RGBA;
+            default:
+                return OF_PIXELS_RGB;
+
+        }
+    }
+    return OF_PIXELS_UNKNOWN;
+}
+
+void ofxHapPlayer::setLoopState(ofLoopType state)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    ofxHap::Clock::Mode mode;
+    switch (state) {
+        case OF_LOOP_PALINDROME:
+            mode = ofxHap::Clock::Mode::Palindrome;
+            break;
+        case OF_LOOP_NONE:
+            mode = ofxHap::Clock::Mode::Once;
+            break;
+        default:
+            mode = ofxHap::Clock::Mode::Loop;
+            break;
+    }
+    if (mode != _clock.mode)
+    {
+        _clock.mode = mode;
+        syncAudio(false);
+    }
+}
+
+ofLoopType ofxHapPlayer::getLoopState() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    switch (_clock.mode) {
+        case ofxHap::Clock::Mode::Once:
+            return OF_LOOP_NONE;
+        case ofxHap::Clock::Mode::Loop:
+            return OF_LOOP_NORMAL;
+        default:
+            return OF_LOOP_PALINDROME;
+    }
+}
+
+float ofxHapPlayer::getSpeed() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.getRate();
+}
+
+void ofxHapPlayer::setSpeed(float speed)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _clock.setRateAt(speed, _frameTime);
+    syncAudio(true);
+}
+
+float ofxHapPlayer::getDuration() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.period / static_cast<float>(AV_TIME_BASE);
+}
+
+bool ofxHapPlayer::getIsMovieDone() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.getDone();
+}
+
+float ofxHapPlayer::getPosition() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_clock.period)
+    {
+        return _clock.getTime() / static_cast<float>(_clock.period);
+    }
+    else
+    {
+        return 0.0;
+    }
+}
+
+void ofxHapPlayer::setPosition(float pct)
+{
+    // TODO: Clock doesn't work if on the reverse phase of a palindrome (skips to forward phase)
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_loaded)
+    {
+        setPositionLoaded(pct);
+    }
+    else
+    {
+        _positionOnLoad = pct;
+        _frameOnLoad = -1;
+    }
+}
+
+void ofxHapPlayer::setPositionLoaded(float pct)
+{
+    int64_t time = ofClamp(pct, 0.0f, 1.0f) * (_clock.period - 1);
+    setPTSLoaded(time);
+}
+
+void ofxHapPlayer::setVideoPTSLoaded(int64_t pts, bool round_up)
+{
+    pts = std::max(std::min(av_rescale_q_rnd(pts, _videoStream->time_base, { 1, AV_TIME_BASE }, round_up ? AV_ROUND_UP : AV_ROUND_DOWN), _clock.period - 1), INT64_C(0));
+    setPTSLoaded(pts);
+}
+
+void ofxHapPlayer::setPTSLoaded(int64_t pts)
+{
+    pts = std::max(std::min(pts, _clock.getOut() - 1), _clock.getIn());
+    _clock.syncAt(pts, _frameTime);
+    syncAudio(false);
+}
+
+void ofxHapPlayer::firstFrame()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_loaded)
+    {
+        int64_t time = _videoStream->start_time;
+        if (time == AV_NOPTS_VALUE)
+        {
+            time = 0;
+        }
+        setVideoPTSLoaded(time, false);
+    }
+    else
+    {
+        _positionOnLoad = 0.0f;
+        _frameOnLoad = -1;
+    }
+}
+
+void ofxHapPlayer::nextFrame()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_loaded && _frameIndex.isValid())
+    {
+        setFrameLoaded(getCurrentFrameLoaded() + 1);
+    }
+    else if (_loaded && _decodedFrame.isValid())
+    {
+        setVideoPTSLoaded(std::min(_decodedFrame.pts + _decodedFrame.duration, _videoStream->duration - 1), true);
+    }
+}
+
+void ofxHapPlayer::previousFrame()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_loaded && _frameIndex.isValid())
+    {
+        setFrameLoaded(getCurrentFrameLoaded() - 1);
+    }
+    else if (_loaded && _decodedFrame.isValid())
+    {
+        setVideoPTSLoaded(_decodedFrame.pts - 1, false);
+    }
+}
+
+float ofxHapPlayer::getVolume() const
+{
+    return _volume;
+}
+
+void ofxHapPlayer::setVolume(float volume)
+{
+    if (volume != _volume)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _volume = ofClamp(volume, 0.0, 1.0);
+        if (_audioThread)
+            _audioThread->setVolume(_volume);
+    }
+}
+
+void ofxHapPlayer::setFrame(int frame)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_loaded)
+    {
+        setFrameLoaded(frame);
+    }
+    else
+    {
+        _frameOnLoad = std::max(frame, 0);
+    }
+}
+
+void ofxHapPlayer::setFrameLoaded(int64_t frame)
+{
+    if (_frameIndex.isValid())
+    {
+        frame = std::max(std::min(frame, _frameIndex.size() - 1), INT64_C(0));
+        setVideoPTSLoaded(_frameIndex.getTime(frame), true);
+    }
+    else if (_videoStream->avg_frame_rate.num > 0)
+    {
+        // Without an index, assume a constant frame rate
+        int64_t start = _videoStream->start_time == AV_NOPTS_VALUE ? 0 : _videoStream->start_time;
+        setVideoPTSLoaded(start + av_rescale_q(std::max(frame, INT64_C(0)), av_inv_q(_videoStream->avg_frame_rate), _videoStream->time_base), true);
+    }
+}
+
+int ofxHapPlayer::getCurrentFrame() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_loaded)
+    {
+        return static_cast<int>(getCurrentFrameLoaded());
+    }
+    return std::max(_frameOnLoad, 0);
+}
+
+int64_t ofxHapPlayer::getCurrentFrameLoaded() const
+{
+    int64_t time = std::max(std::min(_clock.getTime(), _clock.period - 1), INT64_C(0));
+    int64_t pts = av_rescale_q_rnd(time, { 1, AV_TIME_BASE }, _videoStream->time_base, AV_ROUND_DOWN);
+    if (_frameIndex.isValid())
+    {
+        return _frameIndex.getFrame(pts);
+    }
+    else if (_videoStream->avg_frame_rate.num > 0)
+    {
+        int64_t start = _videoStream->start_time == AV_NOPTS_VALUE ? 0 : _videoStream->start_time;
+        return std::max(av_rescale_q_rnd(pts - start, _videoStream->time_base, av_inv_q(_videoStream->avg_frame_rate), AV_ROUND_DOWN), INT64_C(0));
+    }
+    return 0;
+}
+
+int ofxHapPlayer::getTotalNumFrames() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_frameIndex.isValid())
+    {
+        return static_cast<int>(_frameIndex.size());
+    }
+    else if (_videoStream)
+    {
+        return _videoStream->nb_frames;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+void ofxHapPlayer::updatePresentationStatistics(int64_t position, bool waited)
+{
+    if (_clock.getPaused())
+    {
+        // Only measure steady playback
+        _shownPTS = AV_NOPTS_VALUE;
+        return;
+    }
+    _presentation.updates++;
+    if (waited || !_decodedFrame.includes(position))
+    {
+        _presentation.late++;
+    }
+    if (_decodedFrame.isValid() && _decodedFrame.pts != _shownPTS)
+    {
+        if (_shownPTS != AV_NOPTS_VALUE)
+        {
+            // Compare how long the last frame was seen with how long it should have
+            // been, ignoring jumps such as seeks and wrapping around loops
+            int64_t advance = av_rescale_q(_decodedFrame.pts - _shownPTS, _videoStream->time_base, { 1, AV_TIME_BASE });
+            bool forwards = _clock.getDirectionAt(_presentTime) == ofxHap::Clock::Direction::Forwards;
+            double expected = std::abs(advance) / std::fabs(_clock.getRate());
+            double seen = static_cast<double>(_presentTime - _shownSince);
+            if ((advance > 0) == forwards && expected < 4 * std::max(seen, static_cast<double>(_refreshInterval)))
+            {
+                _judderSquares += (seen - expected) * (seen - expected);
+                _judderCount++;
+            }
+        }
+        _shownPTS = _decodedFrame.pts;
+        _shownSince = _presentTime;
+        _presentation.frames++;
+    }
+}
+
+void ofxHapPlayer::updatePresentTime()
+{
+    _refreshInterval = std::max(_suppliedInterval > 0 ? _suppliedInterval : _updateInterval, INT64_C(1));
+    if (!_presentationTiming)
+    {
+        _presentTime = _frameTime;
+    }
+    else if (_suppliedTime != AV_NOPTS_VALUE)
+    {
+        _presentTime = _suppliedTime;
+        _suppliedTime = AV_NOPTS_VALUE;
+    }
+    else
+    {
+        // Estimate the refresh after this update, keeping to a steady grid so small
+        // variations in when we are updated don't change which frame is chosen
+        int64_t now = _frameTime;
+        int64_t next = _presentTime + _refreshInterval;
+        if (next < now - (4 * _refreshInterval) || next > now + (2 * _refreshInterval))
+        {
+            next = now + _refreshInterval;
+        }
+        while (next <= now)
+        {
+            next += _refreshInterval;
+        }
+        _presentTime = next;
+    }
+}
+
+void ofxHapPlayer::setPresentationTiming(bool enabled)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _presentationTiming = enabled;
+}
+
+bool ofxHapPlayer::getPresentationTiming() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _presentationTiming;
+}
+
+void ofxHapPlayer::setPresentationTime(int64_t timestamp, int64_t interval)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _suppliedTime = timestamp;
+    _suppliedInterval = interval;
+}
+
+ofxHapPlayer::PresentationStatistics ofxHapPlayer::getPresentationStatistics() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    PresentationStatistics statistics = _presentation;
+    if (_judderCount > 0)
+    {
+        statistics.judder = static_cast<int64_t>(std::sqrt(_judderSquares / _judderCount));
+    }
+    statistics.interval = _refreshInterval;
+    return statistics;
+}
+
+void ofxHapPlayer::resetPresentationStatistics()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _presentation = PresentationStatistics();
+    _judderSquares = 0.0;
+    _judderCount = 0;
+}
+
+ofxHapPlayer::PresentationStatistics::PresentationStatistics()
+: updates(0), late(0), frames(0), judder(0), interval(0)
+{
+
+}
+
+void ofxHapPlayer::updatePTS()
+{
+    _frameTime = av_gettime_relative();
+    if (_startAt != AV_NOPTS_VALUE && _loaded && static_cast<int64_t>(_frameTime) >= _startAt)
+    {
+        // Start from the scheduled time, not this update, as the audio thread has
+        _clock = getScheduledClock();
+        _startAt = AV_NOPTS_VALUE;
+    }
+    _clock.setTimeAt(_frameTime);
+    updatePresentTime();
+    assert(_clock.getTime() <= _clock.period || _clock.period == 0);
+}
+
+int ofxHapPlayer::getTimeout() const
+{
+    return _timeout.count();
+}
+
+void ofxHapPlayer::setTimeout(int microseconds)
+{
+    _timeout = std::chrono::microseconds(microseconds);
+}
+
+std::string ofxHapPlayer::getDecodedFrameCacheDirectory() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _frameCacheDirectory;
+}
+
+void ofxHapPlayer::setDecodedFrameCacheDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _frameCacheDirectory = directory;
+}
+
+int64_t ofxHapPlayer::getDecodedFrameCacheLimit() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _frameCacheLimit;
+}
+
+void ofxHapPlayer::setDecodedFrameCacheLimit(int64_t bytes)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _frameCacheLimit = bytes;
+}
+
+int64_t ofxHapPlayer::getPreloadBudget() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _preloadBudget;
+}
+
+void ofxHapPlayer::setPreloadBudget(int64_t bytes)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _preloadBudget = bytes;
+}
+
+float ofxHapPlayer::getPreloadProgress() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_demuxer)
+    {
+        return _demuxer->getPreloadProgress();
+    }
+    return 0.0;
+}
+
+bool ofxHapPlayer::isPreloaded() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_demuxer)
+    {
+        return _demuxer->isPreloaded();
+    }
+    return false;
+}
+
+std::string ofxHapPlayer::getMetadataCacheDirectory() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _metadataDirectory;
+}
+
+void ofxHapPlayer::setMetadataCacheDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _metadataDirectory = directory;
+}
+
+bool ofxHapPlayer::getSeparateAudio() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _separateAudio;
+}
+
+void ofxHapPlayer::setSeparateAudio(bool separate)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _separateAudio = separate;
+}
+
+bool ofxHapPlayer::getShareSource() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _shareSource;
+}
+
+void ofxHapPlayer::setShareSource(bool share)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _shareSource = share;
+}
+
+int ofxHapPlayer::getConcurrentReads() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _concurrentReads;
+}
+
+void ofxHapPlayer::setConcurrentReads(int count)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _concurrentReads = std::max(count, 0);
+}
+
+void ofxHapPlayer::setReadAhead(float minimum, float maximum)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _readAhead.setLimits(minimum * kofxHapPlayerUSecPerSec, maximum * kofxHapPlayerUSecPerSec);
+    updateAudioCache();
+}
+
+float ofxHapPlayer::getReadAhead() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return getReadAheadWindow() / static_cast<float>(kofxHapPlayerUSecPerSec);
+}
+
+void ofxHapPlayer::setCacheBehind(float minimum, float maximum)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _cacheBehind.setLimits(minimum * kofxHapPlayerUSecPerSec, maximum * kofxHapPlayerUSecPerSec);
+    updateAudioCache();
+}
+
+float ofxHapPlayer::getCacheBehind() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return getCacheBehindWindow() / static_cast<float>(kofxHapPlayerUSecPerSec);
+}
+
+void ofxHapPlayer::setInPoint(float pct)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _inPoint = ofClamp(pct, 0.0f, 1.0f);
+    setRegionLoaded();
+}
+
+float ofxHapPlayer::getInPoint() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _inPoint;
+}
+
+void ofxHapPlayer::setOutPoint(float pct)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _outPoint = ofClamp(pct, 0.0f, 1.0f);
+    setRegionLoaded();
+}
+
+float ofxHapPlayer::getOutPoint() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _outPoint;
+}
+
+void ofxHapPlayer::setRegionLoaded()
+{
+    int64_t in = static_cast<int64_t>(_inPoint * _clock.period);
+    int64_t out = static_cast<int64_t>(_outPoint * _clock.period);
+    if (out <= in)
+    {
+        out = _clock.period;
+    }
+    // The clock keeps the playhead where it is if it is within the region
+    _clock.setRegionAt(in, out, _frameTime);
+    syncAudio(false);
+}
+
+void ofxHapPlayer::setLoopPreroll(float seconds)
 {
     std::lock_guard<std::mutex> guard(_lock);
-    return _clock.getPaused();
+    _loopPreroll = std::max(static_cast<int64_t>(seconds * kofxHapPlayerUSecPerSec), INT64_C(0));
 }
 
-bool ofxHapPlayer::isLoaded() const
+float ofxHapPlayer::getLoopPreroll() const
 {
     std::lock_guard<std::mutex> guard(_lock);
-    return _loaded;
-}
-
-bool ofxHapPlayer::isPlaying() const
-{
-    return _playing;
+    return _loopPreroll / static_cast<float>(kofxHapPlayerUSecPerSec);
 }
 
-std::string ofxHapPlayer::getError() const
+ofxHap::Demuxer::QueueStatistics ofxHapPlayer::getDemuxerQueueStatistics() const
 {
     std::lock_guard<std::mutex> guard(_lock);
-    return _error;
+    if (_demuxer)
+    {
+        return _demuxer->getQueueStatistics();
+    }
+    return ofxHap::Demuxer::QueueStatistics();
 }
 
-ofPixels& ofxHapPlayer::getPixels()
+ofxHap::Demuxer::StartupTimes ofxHapPlayer::getStartupTimes() const
 {
-    static ofPixels none;
-    return none;
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_demuxer)
+    {
+        return _demuxer->getStartupTimes();
+    }
+    return ofxHap::Demuxer::StartupTimes();
 }
 
-const ofPixels& ofxHapPlayer::getPixels() const
+int64_t ofxHapPlayer::getTimeToFirstFrame() const
 {
-    static ofPixels none;
-    return none;
+    std::lock_guard<std::mutex> guard(_lock);
+    return _firstFrameTime;
 }
 
-ofPixelFormat ofxHapPlayer::getPixelFormat() const
+void ofxHapPlayer::addCue(const std::string& name, float position)
 {
     std::lock_guard<std::mutex> guard(_lock);
-    if (_videoStream)
+    for (auto& cue : _cues)
     {
-#if OFX_HAP_HAS_CODECPAR
-        switch (_videoStream->codecpar->codec_tag) {
-#else
-        switch (_videoStream->codec->codec_tag) {
-#endif
-            case MKTAG('H', 'a', 'p', '5'):
-                return OF_PIXELS_RGBA;
-            default:
-                return OF_PIXELS_RGB;
-
+        if (cue.name == name)
+        {
+            cue.position = position;
+            return;
         }
     }
-    return OF_PIXELS_UNKNOWN;
+    _cues.emplace_back(*this, name, position);
 }
 
-void ofxHapPlayer::setLoopState(ofLoopType state)
+void ofxHapPlayer::removeCue(const std::string& name)
 {
     std::lock_guard<std::mutex> guard(_lock);
-    ofxHap::Clock::Mode mode;
-    switch (state) {
-        case OF_LOOP_PALINDROME:
-            mode = ofxHap::Clock::Mode::Palindrome;
-            break;
-        case OF_LOOP_NONE:
-            mode = ofxHap::Clock::Mode::Once;
-            break;
-        default:
-            mode = ofxHap::Clock::Mode::Loop;
-            break;
-    }
-    if (mode != _clock.mode)
+    _cues.erase(std::remove_if(_cues.begin(), _cues.end(), [&](const Cue& cue) {
+        return cue.name == name;
+    }), _cues.end());
+}
+
+bool ofxHapPlayer::jumpToCue(const std::string& name)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    for (const auto& cue : _cues)
     {
-        _clock.mode = mode;
-        if (_audioThread)
+        if (cue.name == name)
         {
-            _audioThread->sync(_clock, false);
+            if (!_loaded)
+            {
+                _positionOnLoad = cue.position;
+                _frameOnLoad = -1;
+                return true;
+            }
+            _cueTriggered = av_gettime_relative();
+            _cueJumped = true;
+            setPositionLoaded(cue.position);
+            // Use the frame we have ready, unless in and out points moved us elsewhere
+            if (cue.frame->fetch(getVideoPosition(_clock.getTime(), 1), _decodedFrame))
+            {
+                _wantsUpload = true;
+            }
+            return true;
         }
     }
+    return false;
 }
 
-ofLoopType ofxHapPlayer::getLoopState() const
+void ofxHapPlayer::setCueBudget(int64_t bytes)
 {
     std::lock_guard<std::mutex> guard(_lock);
-    switch (_clock.mode) {
-        case ofxHap::Clock::Mode::Once:
-            return OF_LOOP_NONE;
-        case ofxHap::Clock::Mode::Loop:
-            return OF_LOOP_NORMAL;
-        default:
-            return OF_LOOP_PALINDROME;
-    }
+    _cueBudget = bytes;
 }
 
-float ofxHapPlayer::getSpeed() const
+int64_t ofxHapPlayer::getCueBudget() const
 {
     std::lock_guard<std::mutex> guard(_lock);
-    return _clock.getRate();
+    return _cueBudget;
 }
 
-void ofxHapPlayer::setSpeed(float speed)
+int64_t ofxHapPlayer::getCueLatency() const
 {
     std::lock_guard<std::mutex> guard(_lock);
-    _clock.setRateAt(speed, _frameTime);
-    if (_audioThread)
-    {
-        _audioThread->sync(_clock, true);
-    }
+    return _cueLatency;
 }
 
-float ofxHapPlayer::getDuration() const
+void ofxHapPlayer::setMemoryLimit(int64_t bytes)
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    return _clock.period / static_cast<float>(AV_TIME_BASE);
+    ofxHap::MemoryBudget::shared()->setLimit(bytes);
 }
 
-bool ofxHapPlayer::getIsMovieDone() const
+int64_t ofxHapPlayer::getMemoryLimit()
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    return _clock.getDone();
+    return ofxHap::MemoryBudget::shared()->getLimit();
 }
 
-float ofxHapPlayer::getPosition() const
+void ofxHapPlayer::setMemoryPriority(int priority)
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    if (_clock.period)
-    {
-        return _clock.getTime() / static_cast<float>(_clock.period);
-    }
-    else
-    {
-        return 0.0;
-    }
+    _memory.setPriority(priority);
 }
 
-void ofxHapPlayer::setPosition(float pct)
+int ofxHapPlayer::getMemoryPriority() const
 {
-    // TODO: Clock doesn't work if on the reverse phase of a palindrome (skips to forward phase)
-    std::lock_guard<std::mutex> guard(_lock);
-    if (_loaded)
-    {
-        setPositionLoaded(pct);
-    }
-    else
-    {
-        _positionOnLoad = pct;
-    }
+    return _memory.getPriority();
 }
 
-void ofxHapPlayer::setPositionLoaded(float pct)
+int64_t ofxHapPlayer::getMemoryUsage() const
 {
-    int64_t time = ofClamp(pct, 0.0f, 1.0f) * (_clock.period - 1);
-    setPTSLoaded(time);
+    return _memory.getUsage();
 }
 
-void ofxHapPlayer::setVideoPTSLoaded(int64_t pts, bool round_up)
+int64_t ofxHapPlayer::getMemoryUsage(ofxHap::MemoryBudget::Tier tier) const
 {
-    pts = std::max(std::min(av_rescale_q_rnd(pts, _videoStream->time_base, { 1, AV_TIME_BASE }, round_up ? AV_ROUND_UP : AV_ROUND_DOWN), _clock.period - 1), INT64_C(0));
-    setPTSLoaded(pts);
+    return _memory.getUsage(tier);
 }
 
-void ofxHapPlayer::setPTSLoaded(int64_t pts)
+ofxHapPlayer::Cue::Cue(ofxHapPlayer& player, const std::string& n, float p)
+: name(n), position(p), resident(false), frame(new KeptFrame(player))
 {
-    _clock.syncAt(pts, _frameTime);
-    if (_audioThread)
+
+}
+
+ofxHapPlayer::AudioReceiver::AudioReceiver(ofxHapPlayer& player)
+: _player(player)
+{
+
+}
+
+void ofxHapPlayer::AudioReceiver::foundMovie(int64_t duration)
+{
+    // The player's main demuxer reports the movie and its streams
+}
+
+void ofxHapPlayer::AudioReceiver::foundStream(AVStream *stream)
+{
+
+}
+
+void ofxHapPlayer::AudioReceiver::foundAllStreams()
+{
+
+}
+
+void ofxHapPlayer::AudioReceiver::readPacket(AVPacket *packet)
+{
+    // No need to lock
+    if (_player._audioThread && packet->stream_index == _player._audioStreamIndex)
     {
-        _audioThread->sync(_clock, false);
+        _player._audioThread->send(packet);
     }
 }
 
-void ofxHapPlayer::firstFrame()
+void ofxHapPlayer::AudioReceiver::readPackets(const std::vector<AVPacket *>& packets)
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    if (_loaded)
+    // No need to lock
+    std::vector<AVPacket *> audio;
+    for (auto packet : packets)
     {
-        int64_t time = _videoStream->start_time;
-        if (time == AV_NOPTS_VALUE)
+        if (packet->stream_index == _player._audioStreamIndex)
         {
-            time = 0;
+            audio.push_back(packet);
         }
-        setVideoPTSLoaded(time, false);
     }
-    else
+    if (_player._audioThread && audio.size() > 0)
     {
-        _positionOnLoad = 0.0f;
+        _player._audioThread->send(audio);
     }
 }
 
-void ofxHapPlayer::nextFrame()
+void ofxHapPlayer::AudioReceiver::discontinuity()
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    if (_loaded && _decodedFrame.isValid())
+    // No need to lock
+    if (_player._audioThread)
     {
-        setVideoPTSLoaded(std::min(_decodedFrame.pts + _decodedFrame.duration, _videoStream->duration - 1), true);
+        _player._audioThread->flush();
     }
 }
 
-void ofxHapPlayer::previousFrame()
+void ofxHapPlayer::AudioReceiver::endMovie()
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    if (_loaded && _decodedFrame.isValid())
+    // No need to lock
+    if (_player._audioThread)
     {
-        setVideoPTSLoaded(_decodedFrame.pts - 1, false);
+        _player._audioThread->endOfStream();
     }
 }
 
-float ofxHapPlayer::getVolume() const
+void ofxHapPlayer::AudioReceiver::error(int averror)
 {
-    return _volume;
+    _player.error(averror);
 }
 
-void ofxHapPlayer::setVolume(float volume)
+ofxHapPlayer::VideoReceiver::VideoReceiver(ofxHapPlayer& player)
+: _player(player)
 {
-    if (volume != _volume)
-    {
-        std::lock_guard<std::mutex> guard(_lock);
-        _volume = ofClamp(volume, 0.0, 1.0);
-        if (_audioThread)
-            _audioThread->setVolume(_volume);
-    }
+
 }
 
-/*
- // TODO: need clock to understand frame numbers so we have correct position on setFrame()
-void ofxHapPlayer::setFrame(int frame)
+void ofxHapPlayer::VideoReceiver::foundMovie(int64_t duration)
 {
-    if (_demuxer != nullptr && _totalNumFrames > 0)
-    {
-        _demuxer->seekFrame(std::max(0, std::min(frame, _totalNumFrames)));
-    }
+    // The player's main demuxer reports the movie and its streams
 }
-*/
-/*
- // TODO:
-int ofxHapPlayer::getCurrentFrame() const
+
+void ofxHapPlayer::VideoReceiver::foundStream(AVStream *stream)
 {
-    int frameNumber = 0;
-    return frameNumber;
+
 }
-*/
 
-int ofxHapPlayer::getTotalNumFrames() const
+void ofxHapPlayer::VideoReceiver::foundAllStreams()
 {
-    std::lock_guard<std::mutex> guard(_lock);
-    if (_videoStream)
+
+}
+
+void ofxHapPlayer::VideoReceiver::readPacket(AVPacket *packet)
+{
+    // No need to lock
+    if (_player._videoStream && packet->stream_index == _player._videoStream->index)
     {
-        return _videoStream->nb_frames;
+        _player._videoPackets->store(packet);
     }
-    else
+}
+
+void ofxHapPlayer::VideoReceiver::readPackets(const std::vector<AVPacket *>& packets)
+{
+    // No need to lock
+    std::vector<AVPacket *> video;
+    for (auto packet : packets)
     {
-        return 0;
+        if (_player._videoStream && packet->stream_index == _player._videoStream->index)
+        {
+            video.push_back(packet);
+        }
+    }
+    if (video.size() > 0)
+    {
+        _player._videoPackets->store(video);
     }
 }
 
-void ofxHapPlayer::updatePTS()
+void ofxHapPlayer::VideoReceiver::discontinuity()
 {
-    _frameTime = av_gettime_relative();
-    _clock.setTimeAt(_frameTime);
-    assert(_clock.getTime() <= _clock.period || _clock.period == 0);
+    // Readers seek for every range they read. Calling cache() here would move the main
+    // demuxer's reads (or, with a shared source, other players') out of the active set
+    // where limit() could discard them, so leave it alone. limit() discards what
+    // readers read once it falls behind the ranges kept.
 }
 
-int ofxHapPlayer::getTimeout() const
+void ofxHapPlayer::VideoReceiver::endMovie()
 {
-    return _timeout.count();
+
 }
 
-void ofxHapPlayer::setTimeout(int microseconds)
+void ofxHapPlayer::VideoReceiver::error(int averror)
 {
-    _timeout = std::chrono::microseconds(microseconds);
+    _player.error(averror);
 }
 
 ofxHapPlayer::AudioOutput::AudioOutput()
@@ -1138,9 +2764,28 @@ void ofxHapPlayer::stopAudio()
 }
 
 ofxHapPlayer::DecodedFrame::DecodedFrame() :
-    pts(AV_NOPTS_VALUE), duration(0)
+    mapped(nullptr), mappedSize(0), pts(AV_NOPTS_VALUE), duration(0)
+{
+
+}
+
+const char *ofxHapPlayer::DecodedFrame::data() const
+{
+    return mapped ? mapped : buffer.data();
+}
+
+size_t ofxHapPlayer::DecodedFrame::size() const
 {
+    return mapped ? mappedSize : buffer.size();
+}
 
+void ofxHapPlayer::DecodedFrame::share(const ofxHap::SharedSource::Frame& frame)
+{
+    shared = frame.data;
+    mapped = shared->data();
+    mappedSize = shared->size();
+    pts = frame.pts;
+    duration = frame.duration;
 }
 
 bool ofxHapPlayer::DecodedFrame::isValid() const
@@ -1148,6 +2793,11 @@ bool ofxHapPlayer::DecodedFrame::isValid() const
     return (pts != AV_NOPTS_VALUE);
 }
 
+bool ofxHapPlayer::DecodedFrame::includes(int64_t position) const
+{
+    return isValid() && pts <= position && pts + duration > position;
+}
+
 void ofxHapPlayer::DecodedFrame::invalidate()
 {
     pts = AV_NOPTS_VALUE;
@@ -1155,9 +2805,111 @@ void ofxHapPlayer::DecodedFrame::invalidate()
 
 void ofxHapPlayer::DecodedFrame::clear()
 {
+    mapped = nullptr;
+    shared.reset();
     pts = AV_NOPTS_VALUE;
     duration = 0;
     // Force deallocation of the vector's storage
     // (std::vector::clear() is not required to deallocate storage)
     std::vector<char>().swap(buffer);
 }
+
+ofxHapPlayer::KeptFrame::KeptFrame(ofxHapPlayer& player)
+: _player(player), _pool(ofxHap::DemuxPool::decoding()), _packet(nullptr),
+  _start(AV_NOPTS_VALUE), _end(AV_NOPTS_VALUE), _decoding(false)
+{
+
+}
+
+ofxHapPlayer::KeptFrame::~KeptFrame()
+{
+    _pool->remove(this);
+    ofxHap::PacketFree(_packet);
+}
+
+bool ofxHapPlayer::KeptFrame::wants(int64_t position) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    bool requested = _start != AV_NOPTS_VALUE && _start <= position && _end > position;
+    return !requested && !_frame.includes(position);
+}
+
+void ofxHapPlayer::KeptFrame::decode(AVPacket *packet)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    ofxHap::PacketFree(_packet);
+    _packet = packet;
+    _start = packet->pts;
+    _end = packet->pts + packet->duration;
+    _pool->schedule(this);
+}
+
+bool ofxHapPlayer::KeptFrame::fetch(int64_t position, DecodedFrame& frame) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_frame.includes(position))
+    {
+        // Keep frame's buffer for its next decode
+        frame.shared = _frame.shared;
+        frame.mapped = _frame.mapped;
+        frame.mappedSize = _frame.mappedSize;
+        frame.pts = _frame.pts;
+        frame.duration = _frame.duration;
+        return true;
+    }
+    return false;
+}
+
+void ofxHapPlayer::KeptFrame::clear()
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    ofxHap::PacketFree(_packet);
+    _packet = nullptr;
+    _condition.wait(locker, [this]() {
+        return !_decoding;
+    });
+    _start = _end = AV_NOPTS_VALUE;
+    _frame.clear();
+}
+
+size_t ofxHapPlayer::KeptFrame::getBytes() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _frame.size();
+}
+
+bool ofxHapPlayer::KeptFrame::run()
+{
+    std::unique_lock<std::mutex> locker(_lock);
+    AVPacket *packet = _packet;
+    _packet = nullptr;
+    if (!packet)
+    {
+        return false;
+    }
+    _decoding = true;
+    locker.unlock();
+
+    DecodedFrame decoded;
+    bool result = _player.decode(packet, decoded);
+    ofxHap::PacketFree(packet);
+
+    locker.lock();
+    _decoding = false;
+    if (!_packet)
+    {
+        if (result)
+        {
+            // Held so it can be shared, not copied, when it is shown
+            _frame.shared = std::make_shared<const std::vector<char>>(std::move(decoded.buffer));
+            _frame.mapped = _frame.shared->data();
+            _frame.mappedSize = _frame.shared->size();
+            _frame.pts = decoded.pts;
+            _frame.duration = decoded.duration;
+        }
+        // A failed decode is tried again when next wanted
+        _start = _end = AV_NOPTS_VALUE;
+    }
+    _condition.notify_all();
+    return _packet != nullptr;
+}
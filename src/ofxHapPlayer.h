@@ -35,12 +35,21 @@
 #include <ofxHap/Demuxer.h>
 #include <ofxHap/AudioThread.h>
 #include <ofxHap/TimeRangeSet.h>
+#include <ofxHap/MappedFrameCache.h>
+#include <ofxHap/FrameIndex.h>
+#include <ofxHap/AdaptiveWindow.h>
+#include <ofxHap/MemoryBudget.h>
+#include <ofxHap/SharedSource.h>
+#include <ofxHap/DemuxPool.h>
+#include <condition_variable>
 
 namespace ofxHap {
     class AudioThread;
     class RingBuffer;
 }
 
+class ofxHapPlayerGroup;
+
 class ofxHapPlayer : public ofBaseVideoPlayer, public ofxHap::PacketReceiver, public ofxHap::AudioThread::Receiver {
 public:
     ofxHapPlayer();
@@ -91,8 +100,8 @@ public:
     virtual void                setVolume(float volume) override; // 0..1
     virtual void                setLoopState(ofLoopType state) override;
     virtual void                setSpeed(float speed) override;
-/*  virtual void                setFrame(int frame);  // frame 0 = first frame... // TODO: */
-/*  virtual int                 getCurrentFrame() const; // TODO: */
+    virtual void                setFrame(int frame) override;  // frame 0 = first frame...
+    virtual int                 getCurrentFrame() const override;
     virtual int                 getTotalNumFrames() const override;
     virtual ofLoopType          getLoopState() const override;
 
@@ -110,11 +119,181 @@ public:
      */
     int                         getTimeout() const;
     void                        setTimeout(int microseconds);
+
+    /*
+     If set, audio is read from the movie independently of video, so video
+     seeks and slow video reads don't interrupt it. This opens the movie twice,
+     unless it is preloaded. A change takes effect on the next call to load().
+     */
+    bool                        getSeparateAudio() const;
+    void                        setSeparateAudio(bool separate);
+
+    /*
+     If set, players which load the same movie share one reader, the packets
+     it reads and the frames they decode, so mirrored outputs decode each
+     frame once. Each player keeps its own position, speed and audio, which
+     is read separately. Players sharing a movie must be updated from the
+     same thread, as they are by default. Preloaded movies aren't shared.
+     A change takes effect on the next call to load().
+     */
+    bool                        getShareSource() const;
+    void                        setShareSource(bool share);
+
+    /*
+     When the player needs to read from several places in a movie at once
+     (eg the playhead and the start of a loop), it can open extra readers to
+     read them concurrently. By default the number of readers suits the
+     storage the movie is on, with a single reader for spinning disks.
+     Set a count to override that, or 0 for the default.
+     A change takes effect on the next call to load().
+     */
+    int                         getConcurrentReads() const;
+    void                        setConcurrentReads(int count);
+
+    /*
+     The player reads ahead of the playhead and keeps frames behind it. Each
+     window adapts to the measured cost of reading and decoding, between the
+     limits set here in seconds. Equal limits give a fixed window. Longer
+     windows suit slow storage, and shorter ones save memory.
+     */
+    void                        setReadAhead(float minimum, float maximum);
+    float                       getReadAhead() const; // the current window
+    void                        setCacheBehind(float minimum, float maximum);
+    float                       getCacheBehind() const; // the current window
+
+    /*
+     In and out points, as positions (0...1), limit playback to part of the
+     movie. Loop and palindrome modes repeat within them without seeking,
+     and regions of a few seconds are kept entirely in memory.
+     */
+    void                        setInPoint(float pct);
+    float                       getInPoint() const;
+    void                        setOutPoint(float pct);
+    float                       getOutPoint() const;
+
+    /*
+     When looping, the start of the loop is kept read and its first frame
+     decoded ahead of time, so wrapping around never waits on the disk.
+     This sets how much is kept, in seconds, or 0 to keep nothing.
+     */
+    void                        setLoopPreroll(float seconds);
+    float                       getLoopPreroll() const;
+
+    /*
+     If the preload budget is greater than zero, movies which fit within
+     that many bytes are read entirely into memory by load(), and then play
+     without further disk access. Larger movies are streamed as normal.
+     isLoaded() returns false until any preload has completed.
+     A change takes effect on the next call to load().
+     */
+    int64_t                     getPreloadBudget() const;
+    void                        setPreloadBudget(int64_t bytes);
+    float                       getPreloadProgress() const; // 0...1
+    bool                        isPreloaded() const;
+
+    /*
+     If a directory is set, decoded frames are stored in a file there and
+     reused when the same movie is played again, trading disk space for CPU.
+     Use fast local storage. The least recently used files are deleted to
+     keep the directory's cache files within the limit in bytes, and movies
+     too large for it aren't cached. Changes take effect on the next load().
+     */
+    std::string                 getDecodedFrameCacheDirectory() const;
+    void                        setDecodedFrameCacheDirectory(const std::string& directory);
+    int64_t                     getDecodedFrameCacheLimit() const;
+    void                        setDecodedFrameCacheLimit(int64_t bytes);
+
+    /*
+     If a directory is set, the stream details found when a movie is first
+     opened are stored there, and later loads of the same movie skip probing
+     the file. A change takes effect on the next call to load().
+     */
+    std::string                 getMetadataCacheDirectory() const;
+    void                        setMetadataCacheDirectory(const std::string& directory);
+
+    /*
+     Timings for the most recent load(), in microseconds from load() being
+     called, or AV_NOPTS_VALUE if a stage hasn't been reached
+     */
+    ofxHap::Demuxer::StartupTimes getStartupTimes() const;
+    int64_t                     getTimeToFirstFrame() const;
+
+    /*
+     The state of the queue of work for the demuxer, for diagnostics
+     */
+    ofxHap::Demuxer::QueueStatistics getDemuxerQueueStatistics() const;
+
+    /*
+     Cues are named positions (0...1) which can be jumped to at once. Within
+     the budget in bytes, the start of each cue is kept read and its first
+     frame decoded, in the order cues were added, so a jump doesn't wait on
+     the disk. getCueLatency() is the time in microseconds from the latest
+     jump until its frame was uploaded to the texture, or AV_NOPTS_VALUE.
+     */
+    void                        addCue(const std::string& name, float position);
+    void                        removeCue(const std::string& name);
+    bool                        jumpToCue(const std::string& name);
+    void                        setCueBudget(int64_t bytes);
+    int64_t                     getCueBudget() const;
+    int64_t                     getCueLatency() const;
+
+    /*
+     playAt() starts playing at a time from getTimestamp(), such as half a
+     second after a cue. Until then the player holds its current frame, and
+     from its next update reads and decodes the start so it plays on time.
+     isPrerolled() reports whether the first frame is decoded, the start
+     read and its audio ready to play, and stays false if the start came
+     first. Changing the position or speed before the start moves it.
+     Pausing or playing cancels it.
+     */
+    void                        playAt(int64_t timestamp);
+    bool                        isPrerolled() const;
+    static int64_t              getTimestamp(); // microseconds
+
+    /*
+     A frame chosen by update() is seen at the following display refresh.
+     With presentation timing enabled, frames are chosen and read ahead for
+     the time they will be seen, rather than the time of the update, which
+     evens out the cadence of movies at a different rate to the display.
+     If the display's timing is known, pass the time the next frame will be
+     seen (from getTimestamp()) and the refresh interval in microseconds
+     before each update, otherwise they are estimated from how often the
+     player is updated. Players in a group don't use presentation timing.
+     */
+    void                        setPresentationTiming(bool enabled);
+    bool                        getPresentationTiming() const;
+    void                        setPresentationTime(int64_t timestamp, int64_t interval);
+    class PresentationStatistics {
+    public:
+        PresentationStatistics();
+        uint64_t    updates; // while playing
+        uint64_t    late; // updates where the frame for the presentation time wasn't ready
+        uint64_t    frames; // new frames shown
+        int64_t     judder; // RMS microseconds between how long frames were seen and how long they should have been
+        int64_t     interval; // the refresh interval in use, in microseconds
+    };
+    PresentationStatistics      getPresentationStatistics() const;
+    void                        resetPresentationStatistics();
+
+    /*
+     All players share a memory budget. If together their caches hold more
+     than the limit in bytes, or the system runs short of memory, the
+     read-ahead and cache windows of the players with the lowest priority
+     shrink first. A limit of 0 (the default) only responds to the system.
+     */
+    static void                 setMemoryLimit(int64_t bytes);
+    static int64_t              getMemoryLimit();
+    void                        setMemoryPriority(int priority);
+    int                         getMemoryPriority() const;
+    int64_t                     getMemoryUsage() const;
+    int64_t                     getMemoryUsage(ofxHap::MemoryBudget::Tier tier) const;
 private:
+    friend class ofxHapPlayerGroup;
     virtual void    foundMovie(int64_t duration) override;
     virtual void    foundStream(AVStream *stream) override;
     virtual void    foundAllStreams() override;
     virtual void    readPacket(AVPacket *packet) override;
+    virtual void    readPackets(const std::vector<AVPacket *>& packets) override;
     virtual void    discontinuity() override;
     virtual void    endMovie() override;
     virtual void    error(int averror) override;
@@ -124,9 +303,67 @@ private:
     void            setVideoPTSLoaded(int64_t pts, bool round_up);
     void            setPTSLoaded(int64_t pts);
     void            setPositionLoaded(float pct);
+    void            setFrameLoaded(int64_t frame);
+    void            setRegionLoaded();
+    int64_t         getCurrentFrameLoaded() const;
     void            update(ofEventArgs& args);
     void            updatePTS();
-    void            read(ofxHap::TimeRangeSequence& sequence);
+    void            updatePresentTime();
+    void            updatePresentationStatistics(int64_t position, bool waited);
+    void            updateLoaded();
+    // Pins the loop start, any pre-roll and resident cues, returning them and setting preroll
+    ofxHap::TimeRangeSequence   updatePinned(const ofxHap::TimeRange& loopStart, ofxHap::TimeRangeSequence& preroll);
+    void            updatePrerolled(const ofxHap::TimeRangeSequence& preroll, int64_t position);
+    void            keepFrames(const ofxHap::TimeRange& loopStart, const ofxHap::TimeRangeSequence& future, int stride);
+    void            syncAudio(bool soft); // observes any scheduled start
+    ofxHap::Clock   getScheduledClock() const;
+    // Requests ranges not in active or already requested by others, adding them to active.
+    // If playing, the first range in sequence holds the playhead, and is read before other work
+    void            read(ofxHap::Demuxer& demuxer, ofxHap::TimeRangeSet& active, const ofxHap::TimeRangeSet& requested,
+                         ofxHap::TimeRangeSequence& sequence, bool spread, int64_t join, bool playing);
+    ofxHap::Demuxer *getSpareReader();
+    int             getStride() const;
+    int64_t         getStrideFrame(int64_t pts, int stride) const;
+    ofxHap::TimeRange   getFrameRange(int64_t frame) const;
+    ofxHap::TimeRangeSequence   getStrideFrames(const ofxHap::TimeRangeSequence& sequence, int stride) const;
+    ofxHap::TimeRange   getLoopStart() const;
+    int64_t         getVideoPosition(int64_t pts, int stride) const;
+    void            prefetch();
+    void            adapt();
+    void            updateAudioCache();
+    int64_t         getReadAheadWindow() const; // scaled to our memory budget
+    int64_t         getCacheBehindWindow() const;
+    void            updateMemory();
+    // Passes packets from a separate audio demuxer to the audio thread
+    class AudioReceiver : public ofxHap::PacketReceiver {
+    public:
+        AudioReceiver(ofxHapPlayer& player);
+        virtual void    foundMovie(int64_t duration) override;
+        virtual void    foundStream(AVStream *stream) override;
+        virtual void    foundAllStreams() override;
+        virtual void    readPacket(AVPacket *packet) override;
+        virtual void    readPackets(const std::vector<AVPacket *>& packets) override;
+        virtual void    discontinuity() override;
+        virtual void    endMovie() override;
+        virtual void    error(int averror) override;
+    private:
+        ofxHapPlayer    &_player;
+    };
+    // Passes packets from extra video readers to the video cache
+    class VideoReceiver : public ofxHap::PacketReceiver {
+    public:
+        VideoReceiver(ofxHapPlayer& player);
+        virtual void    foundMovie(int64_t duration) override;
+        virtual void    foundStream(AVStream *stream) override;
+        virtual void    foundAllStreams() override;
+        virtual void    readPacket(AVPacket *packet) override;
+        virtual void    readPackets(const std::vector<AVPacket *>& packets) override;
+        virtual void    discontinuity() override;
+        virtual void    endMovie() override;
+        virtual void    error(int averror) override;
+    private:
+        ofxHapPlayer    &_player;
+    };
     class AudioOutput : public ofBaseSoundOutput {
     public:
         AudioOutput();
@@ -148,18 +385,77 @@ private:
     public:
         DecodedFrame();
         bool    isValid() const;
+        bool    includes(int64_t position) const;
         void    invalidate();
         void    clear();
+        const char *data() const;
+        size_t      size() const;
+        void        share(const ofxHap::SharedSource::Frame& frame);
         std::vector<char>   buffer;
+        const char          *mapped; // if set, used in place of buffer
+        std::shared_ptr<const std::vector<char>> shared; // keeps mapped valid for a shared frame
+        size_t              mappedSize;
         int64_t             pts;
         int64_t             duration;
     };
+    // A frame decoded ahead of time on the decoding pool, such as the first frame of a
+    // loop or a cue. Frames it is shown in share its data rather than copying it
+    class KeptFrame : private ofxHap::DemuxPool::Task {
+    public:
+        KeptFrame(ofxHapPlayer& player);
+        ~KeptFrame();
+        bool    wants(int64_t position) const; // neither decoded nor being decoded
+        void    decode(AVPacket *packet); // takes ownership of packet
+        bool    fetch(int64_t position, DecodedFrame& frame) const; // shares the frame if it includes position
+        void    clear(); // waits for any decode in progress
+        size_t  getBytes() const;
+    private:
+        virtual bool run() override;
+        ofxHapPlayer                        &_player;
+        std::shared_ptr<ofxHap::DemuxPool>  _pool;
+        mutable std::mutex                  _lock;
+        std::condition_variable             _condition;
+        AVPacket                            *_packet; // waiting to be decoded
+        int64_t                             _start; // of the packet waiting or being decoded
+        int64_t                             _end;
+        bool                                _decoding;
+        DecodedFrame                        _frame;
+    };
+    bool            decode(AVPacket *packet, DecodedFrame& frame);
+    bool            decodeFrame(AVPacket *packet, DecodedFrame& frame); // decode, and cache and share the result
+    void            keepFrame(KeptFrame& frame, int64_t position); // decode the frame at position ahead of time
+    void            showFrame();
+    bool            findFrame(int64_t position, DecodedFrame& frame); // from the loop, other players or the frame cache
+    bool            loadFrame(int64_t position, bool moved, bool& waited); // into _decodedFrame, waiting if necessary
+    void            pendFrame(int64_t position, bool moved); // a group's player, without waiting
+    // When we are in a group, it decodes and shows our frame alongside the others'
+    enum class Pending {
+        None,
+        Ready,
+        Decode,
+        Missing
+    };
+    Pending         fetchPending(int64_t since); // wait up to our timeout from since for a missing packet
+    void            decodePending();
+    void            presentPending(bool present);
+    class Cue {
+    public:
+        Cue(ofxHapPlayer& player, const std::string& name, float position);
+        std::string     name;
+        float           position;
+        bool            resident; // within the budget
+        std::unique_ptr<KeptFrame>  frame;
+    };
+    ofxHap::TimeRange   getCueRange(const Cue& cue) const;
+    int64_t         getCueCost(const ofxHap::TimeRange& range) const;
+    size_t          getFrameLength() const;
     mutable std::mutex  _lock;
     bool                _loaded;
     std::string         _error;
     AVStream            *_videoStream;
     int                 _audioStreamIndex;
     DecodedFrame        _decodedFrame;
+    KeptFrame           _loopFrame; // the first frame of the loop
     ofxHap::Clock       _clock;
     uint64_t            _frameTime;
     ofShader            _shader;
@@ -168,7 +464,9 @@ private:
     bool                _wantsUpload;
 	string              _moviePath;
     ofxHap::TimeRangeSet _active;
-    ofxHap::LockingPacketCache              _videoPackets;
+    ofxHap::TimeRangeSet _prefetched;
+    ofxHap::FrameIndex  _frameIndex;
+    std::shared_ptr<ofxHap::LockingPacketCache> _videoPackets; // our own, or a shared source's
     std::shared_ptr<ofxHap::Demuxer>        _demuxer;
     std::shared_ptr<ofxHap::RingBuffer>     _buffer;
     std::shared_ptr<ofxHap::AudioThread>   _audioThread;
@@ -176,6 +474,67 @@ private:
     float               _volume;
     std::chrono::microseconds               _timeout;
     float               _positionOnLoad;
+    int                 _frameOnLoad;
+    int64_t             _preloadBudget;
+    std::string         _frameCacheDirectory;
+    std::string         _frameCachePath;
+    int64_t             _frameCacheLimit;
+    std::shared_ptr<ofxHap::MappedFrameCache> _frameCache;
+    std::string         _metadataDirectory;
+    int64_t             _loadTime;
+    int64_t             _firstFrameTime;
+    ofxHap::AdaptiveWindow  _readAhead;
+    ofxHap::AdaptiveWindow  _cacheBehind;
+    int64_t             _decodeTime; // since _lastAdapt
+    int64_t             _decodedMedia;
+    bool                _stalled;
+    int64_t             _lastAdapt;
+    int64_t             _reverseBlock; // extra read-ahead when playing backwards
+    int64_t             _lastUpdate;
+    int64_t             _updateInterval;
+    int64_t             _loopPreroll;
+    ofxHap::TimeRangeSet _pinned; // sent to the audio thread
+    float               _inPoint;
+    float               _outPoint;
+    std::vector<Cue>    _cues;
+    int64_t             _cueBudget;
+    int64_t             _cueTriggered;
+    int64_t             _cueLatency;
+    bool                _cueJumped; // since the last update
+    ofxHap::Demuxer::ReadStatistics _lastReadStatistics; // of the main demuxer and readers together
+    ofxHap::Demuxer::ReadStatistics _lastAudioReadStatistics;
+    ofxHap::MemoryBudget::Client    _memory;
+    float               _memoryScale; // as last applied
+    bool                _separateAudio;
+    bool                _audioSeparated; // for the current movie
+    bool                _shareSource;
+    std::shared_ptr<ofxHap::SharedSource>   _source; // for the current movie
+    AudioReceiver       _audioReceiver;
+    std::shared_ptr<ofxHap::Demuxer>        _audioDemuxer;
+    ofxHap::TimeRangeSet _audioActive;
+    int                 _concurrentReads;
+    int                 _readerLimit; // for the current movie
+    std::string         _readerPath;
+    std::string         _metadataPath;
+    VideoReceiver       _videoReceiver;
+    std::vector<std::shared_ptr<ofxHap::Demuxer>>   _readers;
+    ofxHapPlayerGroup   *_group;
+    Pending             _pending; // for the group's current update
+    DecodedFrame        _pendingFrame;
+    AVPacket            *_pendingPacket;
+    int64_t             _pendingPosition; // of a Missing packet
+    int64_t             _startAt; // scheduled by playAt()
+    bool                _prerolled;
+    bool                _presentationTiming;
+    int64_t             _presentTime; // when the frame chosen by this update will be seen
+    int64_t             _suppliedTime; // by setPresentationTime(), for the next update
+    int64_t             _suppliedInterval;
+    int64_t             _refreshInterval; // as last used
+    PresentationStatistics  _presentation;
+    int64_t             _shownPTS; // the frame being seen, for statistics
+    int64_t             _shownSince;
+    double              _judderSquares;
+    uint64_t            _judderCount;
 };
 
 #endif /* defined(__ofxHapPlayer__) */
@@ -0,0 +1,450 @@
+/*
+ ofxHapPlayerGroup.cpp
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ofxHapPlayerGroup.h"
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/time.h>
+}
+
+ofxHapPlayerGroup::ofxHapPlayerGroup()
+: _frameTime(av_gettime_relative()), _playing(false), _positionOnLoad(0.0), _pool(ofxHap::DemuxPool::decoding()), _decoding(0)
+{
+    _clock.setPausedAt(true, 0);
+    ofAddListener(ofEvents().update, this, &ofxHapPlayerGroup::update);
+}
+
+ofxHapPlayerGroup::~ofxHapPlayerGroup()
+{
+    ofRemoveListener(ofEvents().update, this, &ofxHapPlayerGroup::update);
+    while (size() > 0)
+    {
+        ofxHapPlayer *player;
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            player = &_members.back()->player;
+        }
+        remove(*player);
+    }
+}
+
+void ofxHapPlayerGroup::add(ofxHapPlayer& player)
+{
+    ofxHapPlayerGroup *existing;
+    {
+        std::lock_guard<std::mutex> guard(player._lock);
+        existing = player._group;
+    }
+    if (existing == this)
+    {
+        return;
+    }
+    if (existing)
+    {
+        existing->remove(player);
+    }
+    std::lock_guard<std::mutex> guard(_lock);
+    _members.emplace_back(new Member(*this, player));
+    std::lock_guard<std::mutex> playerGuard(player._lock);
+    player._group = this;
+}
+
+void ofxHapPlayerGroup::remove(ofxHapPlayer& player)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    auto itr = std::find_if(_members.begin(), _members.end(), [&player](const std::unique_ptr<Member>& member) {
+        return &member->player == &player;
+    });
+    if (itr != _members.end())
+    {
+        _pool->remove(itr->get());
+        _members.erase(itr);
+        // The player carries on alone from where the group left it
+        player.presentPending(false);
+        std::lock_guard<std::mutex> playerGuard(player._lock);
+        player._group = nullptr;
+    }
+}
+
+size_t ofxHapPlayerGroup::size() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _members.size();
+}
+
+void ofxHapPlayerGroup::update(ofEventArgs& args)
+{
+    update();
+}
+
+void ofxHapPlayerGroup::update()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+
+    // One time for every player
+    _frameTime = av_gettime_relative();
+
+    // Wait until every player is loaded, and play for the shortest of them
+    int64_t period = 0;
+    bool loaded = _members.size() > 0;
+    for (const auto& member : _members)
+    {
+        std::lock_guard<std::mutex> playerGuard(member->player._lock);
+        if (member->player._loaded)
+        {
+            int64_t duration = member->player._clock.period;
+            period = period ? std::min(period, duration) : duration;
+        }
+        else
+        {
+            // Its audio will need syncing once it has loaded
+            member->synced = false;
+            loaded = false;
+        }
+    }
+    if (!loaded)
+    {
+        return;
+    }
+    if (period != _clock.period)
+    {
+        bool starting = _clock.period == 0;
+        _clock.period = period;
+        if (starting)
+        {
+            _clock.syncAt(static_cast<int64_t>(ofClamp(_positionOnLoad, 0.0f, 1.0f) * (period - 1)), _frameTime);
+            _clock.setPausedAt(!_playing, _frameTime);
+        }
+        for (auto& member : _members)
+        {
+            member->synced = false;
+        }
+    }
+    _clock.setTimeAt(_frameTime);
+    if (_clock.getDone())
+    {
+        _playing = false;
+    }
+
+    // Each player finds its frame for our time, without showing it
+    bool missing = false;
+    std::vector<Member *> decoding;
+    for (auto& member : _members)
+    {
+        ofxHapPlayer& player = member->player;
+        std::lock_guard<std::mutex> playerGuard(player._lock);
+        player._frameTime = _frameTime;
+        player._presentTime = _frameTime;
+        player._clock = _clock;
+        player._playing = _playing;
+        if (!member->synced)
+        {
+            if (player._audioThread)
+            {
+                player._audioThread->sync(player._clock, false);
+            }
+            member->synced = true;
+        }
+        player.updateLoaded();
+        member->decode = player._pending == ofxHapPlayer::Pending::Decode;
+        if (member->decode)
+        {
+            decoding.push_back(member.get());
+        }
+        missing = missing || player._pending == ofxHapPlayer::Pending::Missing;
+    }
+
+    // Players don't wait for packets still being read above, so every player's reads
+    // progress together and we wait for one timeout at most, rather than one for each
+    if (missing)
+    {
+        missing = false;
+        for (auto& member : _members)
+        {
+            ofxHapPlayer::Pending pending = member->player.fetchPending(_frameTime);
+            if (pending == ofxHapPlayer::Pending::Decode && !member->decode)
+            {
+                member->decode = true;
+                decoding.push_back(member.get());
+            }
+            missing = missing || pending == ofxHapPlayer::Pending::Missing;
+        }
+    }
+
+    // Decode every frame at once, one on this thread and the rest on the pool.
+    // If any player's frame wasn't ready, none are shown, so we don't decode
+    _statistics.updates++;
+    if (missing)
+    {
+        _statistics.stalls++;
+    }
+    else if (decoding.size() > 0)
+    {
+        int64_t start = av_gettime_relative();
+        {
+            std::lock_guard<std::mutex> decodeGuard(_decodeLock);
+            _decoding = decoding.size() - 1;
+        }
+        for (size_t i = 1; i < decoding.size(); i++)
+        {
+            _pool->schedule(decoding[i]);
+        }
+        decoding[0]->player.decodePending();
+        std::unique_lock<std::mutex> decodeLocker(_decodeLock);
+        while (_decoding > 0)
+        {
+            _decodeCondition.wait(decodeLocker);
+        }
+        _statistics.decodeTime = av_gettime_relative() - start;
+    }
+
+    // Show every new frame, or none
+    int64_t earliest = INT64_MAX;
+    int64_t latest = INT64_MIN;
+    for (auto& member : _members)
+    {
+        ofxHapPlayer& player = member->player;
+        player.presentPending(!missing);
+        std::lock_guard<std::mutex> playerGuard(player._lock);
+        if (player._decodedFrame.isValid())
+        {
+            int64_t shown = av_rescale_q(player._decodedFrame.pts, player._videoStream->time_base, { 1, AV_TIME_BASE });
+            earliest = std::min(earliest, shown);
+            latest = std::max(latest, shown);
+        }
+    }
+    _statistics.skew = latest > earliest ? latest - earliest : 0;
+    _statistics.maxSkew = std::max(_statistics.maxSkew, _statistics.skew);
+}
+
+void ofxHapPlayerGroup::decoded(Member& member)
+{
+    member.player.decodePending();
+    std::lock_guard<std::mutex> guard(_decodeLock);
+    _decoding--;
+    _decodeCondition.notify_all();
+}
+
+void ofxHapPlayerGroup::sync(bool soft)
+{
+    // Apply a change to our clock to every player at once
+    if (_clock.period == 0)
+    {
+        return;
+    }
+    for (auto& member : _members)
+    {
+        ofxHapPlayer& player = member->player;
+        std::lock_guard<std::mutex> playerGuard(player._lock);
+        if (player._loaded && member->synced)
+        {
+            player._clock = _clock;
+            player._playing = _playing;
+            if (player._audioThread)
+            {
+                player._audioThread->sync(player._clock, soft);
+            }
+        }
+    }
+}
+
+void ofxHapPlayerGroup::play()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _playing = true;
+    if (_clock.period == 0)
+    {
+        return;
+    }
+    bool soft = true;
+    if (_clock.getDone())
+    {
+        _clock.syncAt(_clock.getIn(), _frameTime);
+        soft = false;
+    }
+    _clock.setPausedAt(false, _frameTime);
+    sync(soft);
+}
+
+void ofxHapPlayerGroup::stop()
+{
+    setPaused(true);
+}
+
+void ofxHapPlayerGroup::setPaused(bool pause)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (pause)
+    {
+        _playing = false;
+    }
+    else if (_clock.getPaused())
+    {
+        _playing = true;
+    }
+    if (_clock.period != 0 && _clock.getPaused() != pause)
+    {
+        _clock.setPausedAt(pause, _frameTime);
+        sync(true);
+    }
+}
+
+bool ofxHapPlayerGroup::isPaused() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.period ? _clock.getPaused() : !_playing;
+}
+
+bool ofxHapPlayerGroup::isPlaying() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _playing;
+}
+
+bool ofxHapPlayerGroup::isLoaded() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.period != 0;
+}
+
+float ofxHapPlayerGroup::getDuration() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.period / static_cast<float>(AV_TIME_BASE);
+}
+
+float ofxHapPlayerGroup::getPosition() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_clock.period)
+    {
+        return _clock.getTime() / static_cast<float>(_clock.period);
+    }
+    else
+    {
+        return _positionOnLoad;
+    }
+}
+
+void ofxHapPlayerGroup::setPosition(float pct)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_clock.period)
+    {
+        int64_t time = ofClamp(pct, 0.0f, 1.0f) * (_clock.period - 1);
+        _clock.syncAt(time, _frameTime);
+        sync(false);
+    }
+    else
+    {
+        _positionOnLoad = pct;
+    }
+}
+
+float ofxHapPlayerGroup::getSpeed() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.getRate();
+}
+
+void ofxHapPlayerGroup::setSpeed(float speed)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _clock.setRateAt(speed, _frameTime);
+    sync(true);
+}
+
+ofLoopType ofxHapPlayerGroup::getLoopState() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    switch (_clock.mode) {
+        case ofxHap::Clock::Mode::Once:
+            return OF_LOOP_NONE;
+        case ofxHap::Clock::Mode::Loop:
+            return OF_LOOP_NORMAL;
+        default:
+            return OF_LOOP_PALINDROME;
+    }
+}
+
+void ofxHapPlayerGroup::setLoopState(ofLoopType state)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    ofxHap::Clock::Mode mode;
+    switch (state) {
+        case OF_LOOP_PALINDROME:
+            mode = ofxHap::Clock::Mode::Palindrome;
+            break;
+        case OF_LOOP_NONE:
+            mode = ofxHap::Clock::Mode::Once;
+            break;
+        default:
+            mode = ofxHap::Clock::Mode::Loop;
+            break;
+    }
+    if (mode != _clock.mode)
+    {
+        _clock.mode = mode;
+        sync(false);
+    }
+}
+
+bool ofxHapPlayerGroup::getIsMovieDone() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _clock.getDone();
+}
+
+ofxHapPlayerGroup::Statistics ofxHapPlayerGroup::getStatistics() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _statistics;
+}
+
+void ofxHapPlayerGroup::resetStatistics()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _statistics = Statistics();
+}
+
+ofxHapPlayerGroup::Statistics::Statistics()
+: updates(0), stalls(0), decodeTime(0), skew(0), maxSkew(0)
+{
+
+}
+
+ofxHapPlayerGroup::Member::Member(ofxHapPlayerGroup& g, ofxHapPlayer& p)
+: ofxHap::DemuxPool::Task(true), group(g), player(p), synced(false), decode(false)
+{
+
+}
+
+bool ofxHapPlayerGroup::Member::run()
+{
+    group.decoded(*this);
+    return false;
+}
@@ -0,0 +1,112 @@
+/*
+ ofxHapPlayerGroup.h
+ ofxHapPlayer
+
+ Copyright (c) 2026, the ofxHapPlayer contributors. All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ofxHapPlayerGroup__
+#define __ofxHapPlayerGroup__
+
+#include "ofxHapPlayer.h"
+#include <ofxHap/DemuxPool.h>
+#include <condition_variable>
+
+/*
+ A group plays several players in step, such as the outputs of a video wall.
+ Its players share one clock, which is sampled once each app frame, and their
+ frames are decoded together. A new frame is shown on every player or, if any
+ player's frame isn't ready in time, on none of them. The group's transport
+ controls its players, which ignore their own transport, in and out points
+ while they are in the group. A player can be in one group at a time.
+ */
+class ofxHapPlayerGroup {
+public:
+    ofxHapPlayerGroup();
+    ~ofxHapPlayerGroup();
+    ofxHapPlayerGroup(ofxHapPlayerGroup const &) = delete;
+    ofxHapPlayerGroup& operator=(ofxHapPlayerGroup const &x) = delete;
+
+    void            add(ofxHapPlayer& player);
+    void            remove(ofxHapPlayer& player);
+    size_t          size() const;
+
+    // Called automatically each app frame
+    void            update();
+
+    void            play();
+    void            stop();
+    void            setPaused(bool pause);
+    bool            isPaused() const;
+    bool            isPlaying() const;
+    bool            isLoaded() const; // every player is loaded
+
+    // The group plays for the duration of its shortest movie
+    float           getDuration() const;
+    float           getPosition() const;
+    void            setPosition(float pct);
+    float           getSpeed() const;
+    void            setSpeed(float speed);
+    ofLoopType      getLoopState() const;
+    void            setLoopState(ofLoopType state);
+    bool            getIsMovieDone() const;
+
+    class Statistics {
+    public:
+        Statistics();
+        uint64_t    updates; // with every player loaded
+        uint64_t    stalls; // updates where a frame wasn't ready, so no new frames were shown
+        int64_t     decodeTime; // microseconds to decode the latest batch of frames
+        int64_t     skew; // microseconds between the earliest and latest frames shown
+        int64_t     maxSkew;
+    };
+    Statistics      getStatistics() const;
+    void            resetStatistics();
+private:
+    // Decodes a player's frame on the decoding pool, away from reads
+    class Member : public ofxHap::DemuxPool::Task {
+    public:
+        Member(ofxHapPlayerGroup& group, ofxHapPlayer& player);
+        virtual bool    run() override;
+        ofxHapPlayerGroup   &group;
+        ofxHapPlayer        &player;
+        bool                synced; // audio has been synced to the group
+        bool                decode; // for the current update
+    };
+    void            update(ofEventArgs& args);
+    void            sync(bool soft);
+    void            decoded(Member& member);
+    mutable std::mutex  _lock;
+    ofxHap::Clock       _clock;
+    int64_t             _frameTime;
+    bool                _playing;
+    float               _positionOnLoad;
+    std::vector<std::unique_ptr<Member>>    _members;
+    std::shared_ptr<ofxHap::DemuxPool>      _pool;
+    std::mutex          _decodeLock;
+    std::condition_variable _decodeCondition;
+    size_t              _decoding;
+    Statistics          _statistics;
+};
+
+#endif /* defined(__ofxHapPlayerGroup__) */